@@ -0,0 +1,153 @@
+#pragma once
+
+// Payload compression between modem73 peers. A small LZ77 coder whose
+// history starts with a preset dictionary of strings common in Winlink,
+// APRS, MeshChat/JSON and plain text traffic, so even short packets find
+// matches. Self-contained, no zlib dependency.
+//
+// Stream: [format:1] then tokens
+//   0xxxxxxx             literal run of x+1 bytes, bytes follow
+//   1xxxxxxx [off:2]     match of x+3 bytes, off bytes back in dictionary+output
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace Compress {
+    constexpr uint8_t FORMAT_LZ_DICT1 = 0x01;
+
+    constexpr size_t MIN_MATCH = 3;
+    constexpr size_t MAX_MATCH = 130;
+    constexpr size_t MAX_LITERALS = 128;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr int HASH_BITS = 12;
+    constexpr int MAX_CHAIN = 32;
+    constexpr size_t MAX_OUTPUT = 4 * 1024 * 1024;
+
+    // Changing this breaks interoperability; add a new format instead
+    inline const std::string& dictionary() {
+        static const std::string dict =
+            "Content-Transfer-Encoding: 8bit\r\nContent-Type: text/plain; charset=ISO-8859-1\r\n"
+            "Content-Type: text/plain; charset=UTF-8\r\nMime-Version: 1.0\r\n"
+            "Mid: Date: Type: Private\r\nFrom: To: Cc: Subject: Re: Fwd: Mbo: Body: File: \r\n"
+            "X-Location: X-Via: Winlink Express SMTP: @winlink.org\r\n"
+            "{\"type\":\"message\",\"id\":\"\",\"from\":\"\",\"to\":\"\",\"text\":\"\",\"content\":\"\","
+            "\"timestamp\":\"time\":\"title\":\"fields\":{\"data\":\"name\":\"status\":\"ok\","
+            "\"lat\":\"lon\":\"alt\":\"destination\":\"source\":\"hash\":true,false,null}]\r\n"
+            "!/>=@:;`'_ WIDE1-1,WIDE2-1,WIDE2-2,APRS,TCPIP*,qAR,qAC:>APRS "
+            "CQ CQ CQ de  k pse QSL QTH QRZ? 73 de  RST 599 TNX FB OM \r\n"
+            "The the and that this with for from have will you are your not was were "
+            "message please thank you station received http://https://www. .com .org .net "
+            "0000000000 1234567890 ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz "
+            "\r\n\r\n    ";
+        return dict;
+    }
+
+    inline uint32_t hash3(const uint8_t* p) {
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Returns false (and leaves out undefined) if the result wouldn't be
+    // smaller than the input
+    inline bool compress(const uint8_t* in, size_t n, std::vector<uint8_t>& out) {
+        const std::string& dict = dictionary();
+        const size_t d = dict.size();
+
+        std::vector<uint8_t> buf(d + n);
+        std::memcpy(buf.data(), dict.data(), d);
+        if (n) std::memcpy(buf.data() + d, in, n);
+
+        std::vector<int32_t> head(1u << HASH_BITS, -1);
+        std::vector<int32_t> prev(buf.size(), -1);
+        auto insert = [&](size_t pos) {
+            if (pos + MIN_MATCH > buf.size()) return;
+            uint32_t h = hash3(&buf[pos]);
+            prev[pos] = head[h];
+            head[h] = static_cast<int32_t>(pos);
+        };
+        for (size_t i = 0; i < d; i++) insert(i);
+
+        out.clear();
+        out.reserve(n);
+        out.push_back(FORMAT_LZ_DICT1);
+
+        size_t lit_start = d;
+        auto flush_literals = [&](size_t end) {
+            while (lit_start < end) {
+                size_t run = std::min(MAX_LITERALS, end - lit_start);
+                out.push_back(static_cast<uint8_t>(run - 1));
+                out.insert(out.end(), buf.begin() + lit_start, buf.begin() + lit_start + run);
+                lit_start += run;
+            }
+        };
+
+        size_t pos = d;
+        while (pos < buf.size()) {
+            if (out.size() >= n) return false;
+
+            size_t best_len = 0, best_off = 0;
+            if (pos + MIN_MATCH <= buf.size()) {
+                size_t limit = std::min(MAX_MATCH, buf.size() - pos);
+                int32_t cand = head[hash3(&buf[pos])];
+                for (int chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++, cand = prev[cand]) {
+                    size_t off = pos - cand;
+                    if (off > MAX_OFFSET) break;
+                    size_t len = 0;
+                    while (len < limit && buf[cand + len] == buf[pos + len]) len++;
+                    if (len > best_len) {
+                        best_len = len;
+                        best_off = off;
+                        if (len == limit) break;
+                    }
+                }
+            }
+
+            if (best_len >= MIN_MATCH) {
+                flush_literals(pos);
+                out.push_back(static_cast<uint8_t>(0x80 | (best_len - MIN_MATCH)));
+                out.push_back(static_cast<uint8_t>(best_off >> 8));
+                out.push_back(static_cast<uint8_t>(best_off & 0xFF));
+                for (size_t i = 0; i < best_len; i++) insert(pos + i);
+                pos += best_len;
+                lit_start = pos;
+            } else {
+                insert(pos);
+                pos++;
+            }
+        }
+        flush_literals(pos);
+        return out.size() < n;
+    }
+
+    inline bool decompress(const uint8_t* in, size_t n, std::vector<uint8_t>& out, size_t max_out) {
+        if (n < 1 || in[0] != FORMAT_LZ_DICT1) return false;
+        const std::string& dict = dictionary();
+        const size_t d = dict.size();
+
+        std::vector<uint8_t> buf(dict.begin(), dict.end());
+        buf.reserve(d + std::min(max_out, n * 8));
+        size_t i = 1;
+        while (i < n) {
+            uint8_t tok = in[i++];
+            if (!(tok & 0x80)) {
+                size_t run = size_t(tok) + 1;
+                if (i + run > n || buf.size() - d + run > max_out) return false;
+                buf.insert(buf.end(), in + i, in + i + run);
+                i += run;
+            } else {
+                size_t len = size_t(tok & 0x7F) + MIN_MATCH;
+                if (i + 2 > n) return false;
+                size_t off = (size_t(in[i]) << 8) | in[i + 1];
+                i += 2;
+                if (off == 0 || off > buf.size() || buf.size() - d + len > max_out) return false;
+                size_t from = buf.size() - off;
+                for (size_t k = 0; k < len; k++) buf.push_back(buf[from + k]);
+            }
+        }
+        out.assign(buf.begin() + d, buf.end());
+        return true;
+    }
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+// Bulk object transfer with a rateless code. An object is cut into K
+// symbols, grouped into generations of up to GENERATION_SIZE symbols. Each
+// generation is sent as its source symbols followed by random linear
+// combinations over GF(256) (systematic RLNC), round-robin across
+// generations so a fade hits many generations a little. The receiver needs
+// any k(1+e) symbols of a generation, and decodes incrementally with
+// Gauss-Jordan elimination as frames arrive. There is no return channel.
+//
+// Frame body (inside an Ext::TYPE_FOUNTAIN frame):
+//   [object id:2] [object size:4] [symbol size:2] [generation:2] [esi:4] [symbol]
+// esi < k is source symbol esi of the generation, larger ones are repair
+// symbols whose coefficients follow from (object id, generation, esi).
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#include "gf256.hh"
+
+namespace Fountain {
+    constexpr size_t HEADER_SIZE = 14;
+    constexpr size_t GENERATION_SIZE = 128;
+    constexpr size_t MAX_OBJECT_BYTES = 16 * 1024 * 1024;
+    constexpr size_t MAX_RX_OBJECTS = 4;
+    constexpr int RX_TIMEOUT_MS = 10 * 60 * 1000;
+    constexpr size_t EXTRA_REPAIR = 2;     // on top of the overhead fraction
+    constexpr float MAX_OVERHEAD = 10.0f;  // repair symbols per source symbol
+
+    struct Header {
+        uint16_t object_id = 0;
+        uint32_t object_size = 0;
+        uint16_t symbol_size = 0;
+        uint16_t generation = 0;
+        uint32_t esi = 0;
+    };
+
+    inline void put_header(std::vector<uint8_t>& out, const Header& h) {
+        out.push_back(h.object_id >> 8);
+        out.push_back(h.object_id & 0xFF);
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((h.object_size >> shift) & 0xFF);
+        out.push_back(h.symbol_size >> 8);
+        out.push_back(h.symbol_size & 0xFF);
+        out.push_back(h.generation >> 8);
+        out.push_back(h.generation & 0xFF);
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back((h.esi >> shift) & 0xFF);
+    }
+
+    inline bool get_header(const uint8_t* body, size_t len, Header& h) {
+        if (len < HEADER_SIZE) return false;
+        h.object_id = (body[0] << 8) | body[1];
+        h.object_size = (uint32_t(body[2]) << 24) | (body[3] << 16) | (body[4] << 8) | body[5];
+        h.symbol_size = (body[6] << 8) | body[7];
+        h.generation = (body[8] << 8) | body[9];
+        h.esi = (uint32_t(body[10]) << 24) | (body[11] << 16) | (body[12] << 8) | body[13];
+        return h.symbol_size > 0 && h.object_size > 0 && h.object_size <= MAX_OBJECT_BYTES &&
+               len >= HEADER_SIZE + h.symbol_size;
+    }
+
+    inline size_t symbol_count(size_t object_size, size_t symbol_size) {
+        return (object_size + symbol_size - 1) / symbol_size;
+    }
+
+    inline size_t generation_count(size_t symbols) {
+        return (symbols + GENERATION_SIZE - 1) / GENERATION_SIZE;
+    }
+
+    inline size_t generation_symbols(size_t symbols, size_t gen) {
+        return std::min(GENERATION_SIZE, symbols - gen * GENERATION_SIZE);
+    }
+
+    // Coefficients of a repair symbol, from a splitmix64 stream seeded by its ids
+    inline void coefficients(uint16_t object_id, uint16_t gen, uint32_t esi, uint8_t* out, size_t k) {
+        uint64_t x = (uint64_t(object_id) << 48) ^ (uint64_t(gen) << 32) ^ esi;
+        bool any = false;
+        for (size_t i = 0; i < k; i += 8) {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            for (size_t j = i; j < std::min(k, i + 8); j++) {
+                out[j] = static_cast<uint8_t>(z);
+                z >>= 8;
+                any |= out[j] != 0;
+            }
+        }
+        if (!any) out[0] = 1;
+    }
+}
+
+class FountainEncoder {
+public:
+    FountainEncoder(uint16_t object_id, std::vector<uint8_t> data, size_t symbol_size, float overhead)
+        : data_(std::move(data)) {
+        header_.object_id = object_id;
+        header_.object_size = static_cast<uint32_t>(data_.size());
+        header_.symbol_size = static_cast<uint16_t>(symbol_size);
+        symbols_ = Fountain::symbol_count(data_.size(), symbol_size);
+        generations_ = Fountain::generation_count(symbols_);
+        data_.resize(symbols_ * symbol_size, 0);
+        if (!(overhead >= 0.0f)) overhead = 0.0f;   // NaN too
+        overhead = std::min(overhead, Fountain::MAX_OVERHEAD);
+
+        for (size_t g = 0; g < generations_; g++) {
+            size_t k = Fountain::generation_symbols(symbols_, g);
+            size_t n = k + static_cast<size_t>(std::ceil(k * overhead)) + Fountain::EXTRA_REPAIR;
+            budget_.push_back(n);
+            total_ += n;
+            max_budget_ = std::max(max_budget_, n);
+        }
+        coef_.resize(Fountain::GENERATION_SIZE);
+    }
+
+    // Next frame body, or false once every generation has had its budget
+    bool next(std::vector<uint8_t>& body) {
+        while (round_ < max_budget_) {
+            size_t g = gen_;
+            uint32_t esi = static_cast<uint32_t>(round_);
+            if (++gen_ == generations_) {
+                gen_ = 0;
+                round_++;
+            }
+            if (esi >= budget_[g]) continue;
+
+            build(g, esi, body);
+            sent_++;
+            return true;
+        }
+        return false;
+    }
+
+    uint16_t object_id() const { return header_.object_id; }
+    size_t object_size() const { return header_.object_size; }
+    size_t symbols() const { return symbols_; }
+    size_t frames_total() const { return total_; }
+    size_t frames_sent() const { return sent_; }
+
+private:
+    void build(size_t g, uint32_t esi, std::vector<uint8_t>& body) {
+        size_t t = header_.symbol_size;
+        size_t k = Fountain::generation_symbols(symbols_, g);
+        const uint8_t* src = data_.data() + g * Fountain::GENERATION_SIZE * t;
+
+        Fountain::Header h = header_;
+        h.generation = static_cast<uint16_t>(g);
+        h.esi = esi;
+        body.clear();
+        body.reserve(Fountain::HEADER_SIZE + t);
+        Fountain::put_header(body, h);
+
+        if (esi < k) {
+            body.insert(body.end(), src + esi * t, src + (esi + 1) * t);
+            return;
+        }
+        body.resize(Fountain::HEADER_SIZE + t, 0);
+        uint8_t* out = body.data() + Fountain::HEADER_SIZE;
+        Fountain::coefficients(h.object_id, h.generation, esi, coef_.data(), k);
+        for (size_t i = 0; i < k; i++) {
+            GF256::region_mul_add(out, src + i * t, coef_[i], t);
+        }
+    }
+
+    std::vector<uint8_t> data_;
+    Fountain::Header header_;
+    size_t symbols_ = 0;
+    size_t generations_ = 0;
+    std::vector<size_t> budget_;
+    size_t max_budget_ = 0;
+    size_t total_ = 0;
+    size_t sent_ = 0;
+    size_t round_ = 0;
+    size_t gen_ = 0;
+    std::vector<uint8_t> coef_;
+};
+
+class FountainDecoder {
+public:
+    explicit FountainDecoder(const Fountain::Header& h)
+        : object_size_(h.object_size), symbol_size_(h.symbol_size) {
+        symbols_ = Fountain::symbol_count(object_size_, symbol_size_);
+        gens_.resize(Fountain::generation_count(symbols_));
+    }
+
+    // Returns true if the symbol was innovative
+    bool add(const Fountain::Header& h, const uint8_t* symbol) {
+        if (h.object_size != object_size_ || h.symbol_size != symbol_size_) return false;
+        if (h.generation >= gens_.size()) return false;
+
+        Generation& gen = gens_[h.generation];
+        size_t k = Fountain::generation_symbols(symbols_, h.generation);
+        if (gen.rank == k) return false;
+        if (gen.coef.empty()) {
+            gen.coef.assign(k * k, 0);
+            gen.data.assign(k * symbol_size_, 0);
+            gen.pivot.assign(k, 0);
+        }
+
+        coef_.assign(k, 0);
+        if (h.esi < k) {
+            coef_[h.esi] = 1;
+        } else {
+            Fountain::coefficients(h.object_id, h.generation, h.esi, coef_.data(), k);
+        }
+        row_.assign(symbol, symbol + symbol_size_);
+
+        // Rows are kept in reduced echelon form, so one pass clears every
+        // pivot column
+        for (size_t p = 0; p < k; p++) {
+            uint8_t f = coef_[p];
+            if (!f || !gen.pivot[p]) continue;
+            GF256::region_mul_add(coef_.data(), &gen.coef[p * k], f, k);
+            GF256::region_mul_add(row_.data(), &gen.data[p * symbol_size_], f, symbol_size_);
+        }
+
+        size_t q = 0;
+        while (q < k && coef_[q] == 0) q++;
+        if (q == k) return false;
+
+        uint8_t f = GF256::inv(coef_[q]);
+        GF256::region_mul(coef_.data(), f, k);
+        GF256::region_mul(row_.data(), f, symbol_size_);
+
+        // Back substitution keeps the existing rows free of column q
+        for (size_t r = 0; r < k; r++) {
+            if (!gen.pivot[r]) continue;
+            uint8_t c = gen.coef[r * k + q];
+            if (!c) continue;
+            GF256::region_mul_add(&gen.coef[r * k], coef_.data(), c, k);
+            GF256::region_mul_add(&gen.data[r * symbol_size_], row_.data(), c, symbol_size_);
+        }
+
+        std::memcpy(&gen.coef[q * k], coef_.data(), k);
+        std::memcpy(&gen.data[q * symbol_size_], row_.data(), symbol_size_);
+        gen.pivot[q] = 1;
+        gen.rank++;
+        rank_++;
+
+        // A complete generation is just its source symbols; drop the matrix
+        if (gen.rank == k) {
+            std::vector<uint8_t>().swap(gen.coef);
+        }
+        return true;
+    }
+
+    bool complete() const { return rank_ == symbols_; }
+    size_t rank() const { return rank_; }
+    size_t symbols() const { return symbols_; }
+
+    std::vector<uint8_t> object() const {
+        std::vector<uint8_t> out;
+        out.reserve(symbols_ * symbol_size_);
+        for (const auto& gen : gens_) {
+            out.insert(out.end(), gen.data.begin(), gen.data.end());
+        }
+        out.resize(object_size_);
+        return out;
+    }
+
+private:
+    struct Generation {
+        std::vector<uint8_t> coef;    // k x k, row p holds the pivot for column p
+        std::vector<uint8_t> data;    // k x symbol_size
+        std::vector<uint8_t> pivot;
+        size_t rank = 0;
+    };
+
+    size_t object_size_;
+    size_t symbol_size_;
+    size_t symbols_;
+    size_t rank_ = 0;
+    std::vector<Generation> gens_;
+    std::vector<uint8_t> coef_;
+    std::vector<uint8_t> row_;
+};
+
+// Objects being received, keyed by sender call sign and object id
+class FountainReceiver {
+public:
+    enum class Result { IGNORED, PROGRESS, COMPLETE };
+
+    Result process(const std::string& call, const uint8_t* body, size_t len,
+                   std::vector<uint8_t>& object, size_t& rank, size_t& symbols) {
+        Fountain::Header h;
+        if (!Fountain::get_header(body, len, h)) return Result::IGNORED;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        expire(now);
+
+        auto key = std::make_pair(call, h.object_id);
+        auto it = objects_.find(key);
+        if (it == objects_.end()) {
+            if (objects_.size() >= Fountain::MAX_RX_OBJECTS) evict_oldest();
+            it = objects_.emplace(key, Entry(h)).first;
+        }
+        Entry& e = it->second;
+        e.last_activity = now;
+        if (e.delivered) return Result::IGNORED;
+
+        if (!e.decoder.add(h, body + Fountain::HEADER_SIZE)) return Result::IGNORED;
+        rank = e.decoder.rank();
+        symbols = e.decoder.symbols();
+        if (!e.decoder.complete()) return Result::PROGRESS;
+
+        object = e.decoder.object();
+        // Keep a stub so leftover repair frames aren't decoded again
+        e.delivered = true;
+        e.decoder = FountainDecoder(h);
+        return Result::COMPLETE;
+    }
+
+private:
+    struct Entry {
+        explicit Entry(const Fountain::Header& h) : decoder(h) {}
+        FountainDecoder decoder;
+        std::chrono::steady_clock::time_point last_activity;
+        bool delivered = false;
+    };
+
+    void expire(std::chrono::steady_clock::time_point now) {
+        for (auto it = objects_.begin(); it != objects_.end();) {
+            if (now - it->second.last_activity > std::chrono::milliseconds(Fountain::RX_TIMEOUT_MS)) {
+                it = objects_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void evict_oldest() {
+        auto oldest = objects_.begin();
+        for (auto it = objects_.begin(); it != objects_.end(); ++it) {
+            if (it->second.last_activity < oldest->second.last_activity) oldest = it;
+        }
+        if (oldest != objects_.end()) objects_.erase(oldest);
+    }
+
+    std::map<std::pair<std::string, uint16_t>, Entry> objects_;
+    std::mutex mutex_;
+};
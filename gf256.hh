@@ -0,0 +1,138 @@
+#pragma once
+
+// GF(2^8) arithmetic for the fountain coder, polynomial x^8+x^4+x^3+x^2+1.
+// Region operations use nibble lookup tables with SSSE3 pshufb or NEON tbl
+// when the compiler targets them (the Makefile builds with -march=native),
+// and a full multiplication table otherwise.
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace GF256 {
+
+struct Tables {
+    uint8_t exp[512];
+    uint8_t log[256];
+    uint8_t inv[256];
+    uint8_t mul[256][256];
+    uint8_t lo[256][16];   // c * i
+    uint8_t hi[256][16];   // c * (i << 4)
+
+    Tables() {
+        unsigned x = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11D;
+        }
+        for (int i = 255; i < 512; i++) exp[i] = exp[i - 255];
+        log[0] = 0;
+
+        for (int a = 0; a < 256; a++) {
+            for (int b = 0; b < 256; b++) {
+                mul[a][b] = (a && b) ? exp[log[a] + log[b]] : 0;
+            }
+            inv[a] = a ? exp[255 - log[a]] : 0;
+            for (int i = 0; i < 16; i++) {
+                lo[a][i] = mul[a][i];
+                hi[a][i] = mul[a][i << 4];
+            }
+        }
+    }
+};
+
+inline const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+inline uint8_t mul(uint8_t a, uint8_t b) { return tables().mul[a][b]; }
+inline uint8_t inv(uint8_t a) { return tables().inv[a]; }
+
+// dst ^= src
+inline void region_xor(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+#if defined(__SSSE3__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, s));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+#endif
+    for (; i < len; i++) dst[i] ^= src[i];
+}
+
+// dst ^= c * src
+inline void region_mul_add(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len) {
+    if (c == 0) return;
+    if (c == 1) {
+        region_xor(dst, src, len);
+        return;
+    }
+    const Tables& t = tables();
+    size_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo[c]));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi[c]));
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(s, mask)),
+                                  _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, p));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lo = vld1q_u8(t.lo[c]);
+    const uint8x16_t hi = vld1q_u8(t.hi[c]);
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t p = veorq_u8(vqtbl1q_u8(lo, vandq_u8(s, mask)), vqtbl1q_u8(hi, vshrq_n_u8(s, 4)));
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), p));
+    }
+#endif
+    const uint8_t* row = t.mul[c];
+    for (; i < len; i++) dst[i] ^= row[src[i]];
+}
+
+// dst *= c
+inline void region_mul(uint8_t* dst, uint8_t c, size_t len) {
+    if (c == 1) return;
+    const Tables& t = tables();
+    size_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.lo[c]));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.hi[c]));
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(s, mask)),
+                                  _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), p);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lo = vld1q_u8(t.lo[c]);
+    const uint8x16_t hi = vld1q_u8(t.hi[c]);
+    const uint8x16_t mask = vdupq_n_u8(0x0F);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t s = vld1q_u8(dst + i);
+        vst1q_u8(dst + i, veorq_u8(vqtbl1q_u8(lo, vandq_u8(s, mask)), vqtbl1q_u8(hi, vshrq_n_u8(s, 4))));
+    }
+#endif
+    const uint8_t* row = t.mul[c];
+    for (; i < len; i++) dst[i] = row[dst[i]];
+}
+
+} // namespace GF256
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <csignal>
 #include <cstring>
+#include <cstdio>
 #include <cmath>
 
 #ifndef M_PI
@@ -12,16 +13,25 @@
 #include <vector>
 #include <list>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <random>
 
 // Network - Windows compat (zastępuje POSIX socket headers)
 #include "windows_socket_compat.hh"
+#ifndef _WIN32
+#include <sys/un.h>
+#include <poll.h>
+#endif
 #include <sys/stat.h>
 #include <io.h>
 
 // Local includes
 #include "kiss_tnc.hh"
+#include "fountain.hh"
+#include "compress.hh"
+#include "shm_ring.hh"
+#include "rt_sched.hh"
 #include "miniaudio_audio.hh"
 #include "rigctl_ptt.hh"
 #include "serial_ptt.hh"
@@ -62,7 +72,7 @@ void signal_handler(int /*sig*/) {
 
 
 
-#ifndef MODEM73_GUI_MODE
+#if !defined(MODEM73_GUI_MODE) && !defined(MODEM73_LIB_MODE)
 inline void ui_log(const std::string& msg) {
 #ifdef WITH_UI
     if (g_ui_state) {
@@ -74,7 +84,7 @@ inline void ui_log(const std::string& msg) {
     }
 }
 #else
-// ui_log defined in modem73_gui.cc
+// ui_log defined in modem73_gui.cc, or with the library API below
 void ui_log(const std::string& msg);
 #endif
 
@@ -105,16 +115,30 @@ bool check_port_available(const std::string& bind_address, int port) {
 class ClientConnection {
 public:
     int fd;
+    uint64_t id = 0;
+    ShmRing::Transport* shm = nullptr;   // shared-memory client, fd unused
     KISSParser parser;
+    RxFilter filter;   // guarded by the TNC's clients_mutex_
     std::vector<uint8_t> write_buffer;
     std::mutex write_mutex;
     bool connected = true;
     
-    ClientConnection(int fd, std::function<void(uint8_t, uint8_t, const std::vector<uint8_t>&)> callback)
-        : fd(fd), parser(callback) {}
+    using FrameCallback = std::function<void(ClientConnection&, uint8_t, uint8_t, const std::vector<uint8_t>&)>;
+    
+    ClientConnection(int fd, FrameCallback callback)
+        : fd(fd), parser([this, callback](uint8_t port, uint8_t cmd, const std::vector<uint8_t>& data) {
+              callback(*this, port, cmd, data);
+          }) {}
     
     void send(const std::vector<uint8_t>& data) {
         std::lock_guard<std::mutex> lock(write_mutex);
+        if (shm && write_buffer.empty() && shm->attached()) {
+            // Straight into the ring; it rings the client's bell, so nothing
+            // waits for the next pass of the client loop
+            size_t written = shm->tx().write(data.data(), data.size());
+            write_buffer.insert(write_buffer.end(), data.begin() + written, data.end());
+            return;
+        }
         write_buffer.insert(write_buffer.end(), data.begin(), data.end());
     }
     
@@ -122,6 +146,17 @@ public:
         std::lock_guard<std::mutex> lock(write_mutex);
         if (write_buffer.empty()) return true;
         
+        if (shm) {
+            // Nobody to read it yet
+            if (!shm->attached()) {
+                write_buffer.clear();
+                return true;
+            }
+            size_t written = shm->tx().write(write_buffer.data(), write_buffer.size());
+            write_buffer.erase(write_buffer.begin(), write_buffer.begin() + written);
+            return true;
+        }
+        
         ssize_t sent = ::send(fd, (const char*)write_buffer.data(), (int)write_buffer.size(), 0);
         if (sent < 0) {
             if (WSAGetLastError() == WSAEWOULDBLOCK) return true;
@@ -161,6 +196,15 @@ public:
         };
 #endif
         
+        decoder_->crc_error_callback = [this]() {
+            // A station first heard through a failed frame still gets a hello
+            if (peers_.update_link(decoder_->get_last_call_sign(), false, 0,
+                                   config_.adaptive_margin_db, config_.adaptive_hysteresis_db) &&
+                local_caps() != 0) {
+                hello_pending_ = true;
+            }
+        };
+        
         // Init modem configuration
         modem_config_.sample_rate = config.sample_rate;
         modem_config_.center_freq = config.center_freq;
@@ -180,45 +224,31 @@ public:
         
         payload_size_ = encoder_->get_payload_size(modem_config_.oper_mode);
         std::cerr << "Payload size: " << payload_size_ << " bytes" << std::endl;
+        
+        tx_queue_.configure(std::max(config.tx_queue_max_frames, 0), std::max(config.tx_queue_max_bytes, 0),
+                            config.tx_frame_ttl_ms, config.tx_drop_policy);
+        rx_dups_.configure(config.dedup_window_ms);
+        tx_dups_.configure(config.dedup_window_ms);
+        carrier_.configure(config.sample_rate, config.carrier_sense_ms);
+        noise_.configure(config.sample_rate, config.noise_window_s);
+        tx_queue_.configure_fairness(config.tx_fairness, [this](size_t bytes) { return frame_airtime(bytes); });
+        
+        Modes::Info base;
+        float frame_s = Modes::info(modem_config_.oper_mode, base) ? base.duration : 0;
+        frame_s += (config.tx_delay_ms + config.ptt_delay_ms + config.ptt_tail_ms) / 1000.0f;
+        arq_.configure(config.arq_window > 0 ? config.arq_window : Arq::window_for(frame_s),
+                       config.arq_max_retries,
+                       config.tx_frame_ttl_ms > 0 ? config.tx_frame_ttl_ms : ARQ_STALL_MS);
+        
+        next_object_id_ = static_cast<uint16_t>(std::random_device{}());
+        
+        // Announce extension support once on startup
+        hello_pending_ = local_caps() != 0;
+        last_hello_ = std::chrono::steady_clock::now() - std::chrono::milliseconds(Ext::HELLO_INTERVAL_MS);
     }
     
     void run() {
-        audio_ = std::make_unique<MiniAudio>(config_.audio_input_device, 
-                                             config_.audio_output_device,
-                                             config_.sample_rate);
-        if (!audio_->open_playback()) {
-            throw std::runtime_error("Failed to open audio input");
-        }
-        if (!audio_->open_capture()) {
-            throw std::runtime_error("Failed to open audio capture");
-        }
-        
-        std::cerr << "Audio input:  " << config_.audio_input_device << std::endl;
-        std::cerr << "Audio output: " << config_.audio_output_device << std::endl;
-        
-        // Initialize PTT based on ptt_type
-        if (config_.ptt_type == PTTType::RIGCTL) {
-            rigctl_ = std::make_unique<RigctlPTT>(config_.rigctl_host, config_.rigctl_port);
-            if (!rigctl_->connect()) {
-                std::cerr << "Could not connect to rigctl" << std::endl;
-            }
-        } else if (config_.ptt_type == PTTType::COM) {
-            serial_ptt_ = std::make_unique<SerialPTT>();
-            if (!serial_ptt_->open(config_.com_port, 
-                                   static_cast<PTTLine>(config_.com_ptt_line),
-                                   config_.com_invert_dtr, 
-                                   config_.com_invert_rts)) {
-                std::cerr << "Could not open COM port: " << serial_ptt_->last_error() << std::endl;
-            }
-#ifdef WITH_CM108
-        } else if (config_.ptt_type == PTTType::CM108) {
-            cm108_ptt_ = std::make_unique<CM108PTT>();
-            cm108_ptt_->open(config_.cm108_gpio);
-#endif
-        } else {
-            dummy_ptt_ = std::make_unique<DummyPTT>();
-            dummy_ptt_->connect();
-        }
+        open_devices();
         
         server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
         if (server_fd_ < 0) {
@@ -248,47 +278,15 @@ public:
         u_long nb = 1; ioctlsocket(server_fd_, FIONBIO, &nb);
         
         std::cerr << "KISS TNC listening on " << config_.bind_address << ":" << config_.port << std::endl;
-        std::cerr << "Callsign: " << config_.callsign << std::endl;
-        std::cerr << "Modulation: " << config_.modulation << " " << config_.code_rate 
-                  << " " << (config_.short_frame ? "short" : "normal") << std::endl;
-        std::cerr << "Payload: " << payload_size_ << " bytes (including 2-byte length prefix)" << std::endl;
         
-        if (config_.csma_enabled) {
-            std::cerr << "CSMA: enabled (threshold=" << config_.carrier_threshold_db 
-                      << " dB, slot=" << config_.slot_time_ms 
-                      << " ms, p=" << config_.p_persistence << "/255)" << std::endl;
-        } else {
-            std::cerr << "CSMA: disabled" << std::endl;
+        if (!config_.unix_socket.empty()) {
+            open_unix_socket();
         }
-        
-        std::cerr << "Fragmentation: " << (config_.fragmentation_enabled ? "enabled" : "disabled") << std::endl;
-        std::cerr << "TX Blanking: " << (config_.tx_blanking_enabled ? "enabled" : "disabled") << std::endl;
-        
-        // Show PTT status
-        switch (config_.ptt_type) {
-            case PTTType::NONE:
-                std::cerr << "PTT: disabled" << std::endl;
-                break;
-            case PTTType::RIGCTL:
-                std::cerr << "PTT: rigctl " << config_.rigctl_host << ":" << config_.rigctl_port << std::endl;
-                break;
-            case PTTType::VOX:
-                std::cerr << "PTT: VOX " << config_.vox_tone_freq << "Hz" << std::endl;
-                break;
-            case PTTType::COM:
-                std::cerr << "PTT: COM " << config_.com_port 
-                          << " (" << PTT_LINE_OPTIONS[config_.com_ptt_line] << ")" << std::endl;
-                break;
-#ifdef WITH_CM108
-            case PTTType::CM108:
-                std::cerr << "PTT: CM108 (GPIO" << config_.cm108_gpio << ")" << std::endl;
-                break;
-#endif
+        if (!config_.shm_name.empty()) {
+            open_shm_transport();
         }
-        
-        // Start threads
-        std::thread rx_thread(&KISSTNC::rx_loop, this);
-        std::thread tx_thread(&KISSTNC::tx_loop, this);
+        log_settings();
+        start_threads();
         
         // Main  
         while (g_running) {
@@ -305,19 +303,16 @@ public:
                 char ip_str[INET_ADDRSTRLEN];
                 inet_ntop(AF_INET, &client_addr.sin_addr, ip_str, sizeof(ip_str));
                 ui_log(std::string("Client connected: ") + ip_str + ":" + std::to_string(ntohs(client_addr.sin_port)));
-                
-                auto callback = [this](uint8_t port, uint8_t cmd, const std::vector<uint8_t>& data) {
-                    handle_kiss_frame(port, cmd, data);
-                };
-                
-                std::lock_guard<std::mutex> lock(clients_mutex_);
-                clients_.emplace_back(std::make_unique<ClientConnection>(client_fd, callback));
-                
-#ifdef WITH_UI
-                if (g_ui_state) {
-                    g_ui_state->client_count = clients_.size();
+                add_client(client_fd);
+            }
+            
+            if (unix_fd_ >= 0) {
+                int local_fd = accept(unix_fd_, nullptr, nullptr);
+                if (local_fd >= 0) {
+                    { u_long nb = 1; ioctlsocket(local_fd, FIONBIO, &nb); }
+                    ui_log("Client connected: " + config_.unix_socket);
+                    add_client(local_fd);
                 }
-#endif
             }
             
             // Poll clients for data
@@ -326,11 +321,15 @@ public:
                 for (auto it = clients_.begin(); it != clients_.end();) {
                     auto& client = *it;
                     
+                    // Served by shm_loop
+                    if (client->shm) {
+                        ++it;
+                        continue;
+                    }
+                    
                     // Read data
                     uint8_t buf[4096];
-                    ssize_t n = recv(client->fd, (char*)buf, (int)sizeof(buf), 0);
-                    
-                    if (n > 0) {
+                    if (ssize_t n = recv(client->fd, (char*)buf, (int)sizeof(buf), 0); n > 0) {
                         client->parser.process(buf, n);
                     } else if (n == 0 || (n < 0 && WSAGetLastError() != WSAEWOULDBLOCK)) {
                         // Disconnected
@@ -362,63 +361,365 @@ public:
                 }
             }
             
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            wait_for_clients();
         }
         
         // Cleanup
-        tx_running_ = false;
-        rx_running_ = false;
-        
-        tx_thread.join();
-        rx_thread.join();
+        stop();
+        if (shm_thread_.joinable()) shm_thread_.join();
         
         for (auto& client : clients_) {
-            WIN_CLOSE_SOCKET(client->fd);
+            if (!client->shm) WIN_CLOSE_SOCKET(client->fd);
         }
         WIN_CLOSE_SOCKET(server_fd_);
+        if (unix_fd_ >= 0) {
+            WIN_CLOSE_SOCKET(unix_fd_);
+            std::remove(config_.unix_socket.c_str());
+        }
+        if (shm_) {
+            shm_->close();
+        }
+    }
+    
+    // Modem without the KISS server, for in-process use (libmodem73): 
+    // frames go in through submit() and come out through on_rx_frame
+    void start() {
+        open_devices();
+        log_settings();
+        start_threads();
+    }
+    
+    void stop() {
+        tx_running_ = false;
+        rx_running_ = false;
+        channel_cv_.notify_all();
+        lockout_cv_.notify_all();
+        
+        if (tx_thread_.joinable()) tx_thread_.join();
+        if (rx_thread_.joinable()) rx_thread_.join();
     }
     
 private:
-    void handle_kiss_frame(uint8_t /*port*/, uint8_t cmd, const std::vector<uint8_t>& data) {
-        if (cmd == KISS::CMD_DATA) {
-            if (g_verbose) {
-                std::cerr << kiss_frame_visualize(data.data(), data.size()) << std::endl;
+    void open_devices() {
+        if (audio_ && audio_->is_stream()) {
+            std::cerr << "Audio: caller-provided sample stream" << std::endl;
+        } else {
+            audio_ = std::make_unique<MiniAudio>(config_.audio_input_device, 
+                                                 config_.audio_output_device,
+                                                 config_.sample_rate,
+                                                 config_.audio_buffer_ms);
+            if (!audio_->open_playback()) {
+                throw std::runtime_error("Failed to open audio input");
+            }
+            if (!audio_->open_capture()) {
+                throw std::runtime_error("Failed to open audio capture");
             }
             
-            size_t max_payload = payload_size_ - 2;
-            
-            if (config_.fragmentation_enabled && fragmenter_.needs_fragmentation(data.size(), max_payload)) {
-                auto fragments = fragmenter_.fragment(data, max_payload);
-                ui_log("TX: Fragmenting " + std::to_string(data.size()) + " bytes into " + 
-                       std::to_string(fragments.size()) + " fragments");
-                for (auto& frag : fragments) {
-                    if (g_verbose) {
-                        std::cerr << packet_visualize(frag.data(), frag.size(), true, true) << std::endl;
-                    }
-                    tx_queue_.push(std::move(frag));
-                }
-#ifdef WITH_UI
-                if (g_ui_state) {
-                    g_ui_state->tx_queue_size = tx_queue_.size();
-                }
+            std::cerr << "Audio input:  " << config_.audio_input_device << std::endl;
+            std::cerr << "Audio output: " << config_.audio_output_device << std::endl;
+            std::cerr << "Audio buffer: " << audio_->capture_capacity() << " frames" << std::endl;
+        }
+        
+        // Initialize PTT based on ptt_type
+        if (config_.ptt_type == PTTType::RIGCTL) {
+            rigctl_ = std::make_unique<RigctlPTT>(config_.rigctl_host, config_.rigctl_port);
+            if (!rigctl_->connect()) {
+                std::cerr << "Could not connect to rigctl" << std::endl;
+            }
+        } else if (config_.ptt_type == PTTType::COM) {
+            serial_ptt_ = std::make_unique<SerialPTT>();
+            if (!serial_ptt_->open(config_.com_port, 
+                                   static_cast<PTTLine>(config_.com_ptt_line),
+                                   config_.com_invert_dtr, 
+                                   config_.com_invert_rts)) {
+                std::cerr << "Could not open COM port: " << serial_ptt_->last_error() << std::endl;
+            }
+#ifdef WITH_CM108
+        } else if (config_.ptt_type == PTTType::CM108) {
+            cm108_ptt_ = std::make_unique<CM108PTT>();
+            cm108_ptt_->open(config_.cm108_gpio);
 #endif
+        } else {
+            dummy_ptt_ = std::make_unique<DummyPTT>();
+            dummy_ptt_->connect();
+        }
+    }
+    
+    void log_settings() {
+        std::cerr << "Callsign: " << config_.callsign << std::endl;
+        std::cerr << "Modulation: " << config_.modulation << " " << config_.code_rate 
+                  << " " << (config_.short_frame ? "short" : "normal")
+                  << (config_.auto_frame_length ? " (auto length)" : "") << std::endl;
+        std::cerr << "Payload: " << payload_size_ << " bytes (including 2-byte length prefix)" << std::endl;
+        
+        if (config_.csma_enabled) {
+            const char* detect = config_.csma_detect == CsmaDetect::DCD ? "dcd"
+                               : config_.csma_detect == CsmaDetect::EITHER ? "energy or dcd" : "energy";
+            std::cerr << "CSMA: enabled (" << detect << ", threshold=";
+            if (config_.csma_auto_threshold) {
+                std::cerr << "noise floor + " << config_.csma_margin_db << " dB, "
+                          << config_.carrier_threshold_db << " dB until settled";
+            } else {
+                std::cerr << config_.carrier_threshold_db << " dB";
+            }
+            std::cerr << ", slot=" << config_.slot_time_ms 
+                      << " ms, p=" << config_.p_persistence << "/255)" << std::endl;
+        } else {
+            std::cerr << "CSMA: disabled" << std::endl;
+        }
+        std::cerr << "RX guard: " << config_.rx_guard_ms << " ms after the decoder goes quiet" << std::endl;
+        
+        std::cerr << "TX queue: max " << config_.tx_queue_max_frames << " frames, "
+                  << config_.tx_queue_max_bytes << " bytes, TTL "
+                  << config_.tx_frame_ttl_ms << " ms, "
+                  << (config_.tx_drop_policy == TxDropPolicy::HEAD ? "head" : "tail") << "-drop"
+                  << (config_.tx_fairness ? ", fair (DRR)" : "") << std::endl;
+        std::cerr << "Fragmentation: " << (config_.fragmentation_enabled ? "enabled" : "disabled") << std::endl;
+        std::cerr << "Adaptive modulation: ";
+        if (config_.adaptive_mode) {
+            std::cerr << "enabled (margin=" << config_.adaptive_margin_db 
+                      << " dB, hysteresis=" << config_.adaptive_hysteresis_db << " dB)" << std::endl;
+        } else {
+            std::cerr << "disabled" << std::endl;
+        }
+        std::cerr << "Aggregation: " << (config_.aggregation == AggregationMode::ON ? "on" :
+                                         config_.aggregation == AggregationMode::AUTO ? "auto" : "off") << std::endl;
+        std::cerr << "ARQ: ";
+        if (config_.arq_enabled) {
+            std::cerr << "enabled (window=" << (config_.arq_window > 0 ? std::to_string(config_.arq_window) : "auto")
+                      << ", retries=" << config_.arq_max_retries << ")" << std::endl;
+        } else {
+            std::cerr << "disabled" << std::endl;
+        }
+        std::cerr << "Compression: " << (config_.compression ? "enabled" : "disabled") << std::endl;
+        std::cerr << "Header compression: " << (config_.header_compression ? "enabled" : "disabled") << std::endl;
+        std::cerr << "Bulk transfer: ";
+        if (config_.bulk_threshold > 0) {
+            std::cerr << "payloads >= " << config_.bulk_threshold << " bytes, overhead "
+                      << (int)(config_.bulk_overhead * 100) << "%" << std::endl;
+        } else {
+            std::cerr << "disabled" << std::endl;
+        }
+        std::cerr << "Duplicate suppression: ";
+        if (config_.dedup_rx || config_.dedup_tx) {
+            std::cerr << (config_.dedup_rx ? "RX " : "") << (config_.dedup_tx ? "TX " : "")
+                      << "within " << config_.dedup_window_ms << " ms" << std::endl;
+        } else {
+            std::cerr << "disabled" << std::endl;
+        }
+        std::cerr << "TX Blanking: " << (config_.tx_blanking_enabled ? "enabled" : "disabled") << std::endl;
+        
+        // Show PTT status
+        switch (config_.ptt_type) {
+            case PTTType::NONE:
+                std::cerr << "PTT: disabled" << std::endl;
+                break;
+            case PTTType::RIGCTL:
+                std::cerr << "PTT: rigctl " << config_.rigctl_host << ":" << config_.rigctl_port << std::endl;
+                break;
+            case PTTType::VOX:
+                std::cerr << "PTT: VOX " << config_.vox_tone_freq << "Hz" << std::endl;
+                break;
+            case PTTType::COM:
+                std::cerr << "PTT: COM " << config_.com_port 
+                          << " (" << (config_.com_ptt_line == 0 ? "DTR" : config_.com_ptt_line == 1 ? "RTS" : "BOTH")
+                          << ")" << std::endl;
+                break;
+#ifdef WITH_CM108
+            case PTTType::CM108:
+                std::cerr << "PTT: CM108 (GPIO" << config_.cm108_gpio << ")" << std::endl;
+                break;
+#endif
+        }
+    }
+    
+    void start_threads() {
+        // Before the threads take over the decoder and encoder
+        if (config_.rt_mlock) prefault_dsp();
+        {
+            std::lock_guard<std::mutex> lock(rt_mutex_);
+            rt_ready_ = 0;
+        }
+        tx_running_ = true;
+        rx_running_ = true;
+        rx_thread_ = std::thread(&KISSTNC::rx_loop, this);
+        tx_thread_ = std::thread(&KISSTNC::tx_loop, this);
+        
+        // Once both have touched their stacks, so the lock covers them too
+        if (config_.rt_mlock) {
+            std::unique_lock<std::mutex> lock(rt_mutex_);
+            rt_cv_.wait_for(lock, std::chrono::seconds(1), [this] { return rt_ready_ >= 2; });
+            lock.unlock();
+            std::string result;
+            if (RtSched::lock_memory(result)) {
+                std::cerr << "RT: memory " << result << std::endl;
             } else {
-                std::vector<uint8_t> frame_data = data;
-                if (frame_data.size() > max_payload) {
-                    std::cerr << "Warning: Frame too large (" << frame_data.size() 
-                              << " > " << max_payload << "), truncating" << std::endl;
-                    frame_data.resize(max_payload);
+                std::cerr << "RT: memory lock " << result << ", continuing unlocked" << std::endl;
+            }
+        }
+    }
+    
+    // Runs the decoder over a second of silence and encodes a full frame,
+    // so the pages of their working buffers are mapped before mlockall()
+    // pins them and the first real frame doesn't fault them in. Only
+    // before the DSP threads run.
+    void prefault_dsp() {
+        std::vector<float> silence(config_.sample_rate, 0.0f);
+        decoder_->process(silence.data(), silence.size(), [](const uint8_t*, size_t) {});
+        decoder_->reset();
+        std::vector<uint8_t> frame(payload_size_, 0);
+        encoder_->encode(frame.data(), frame.size(), modem_config_.center_freq,
+                         modem_config_.call_sign, modem_config_.oper_mode);
+    }
+    
+    // Real-time class and CPU for the calling DSP thread, as configured;
+    // reports what was granted and runs on regardless
+    void apply_rt_settings(const char* name, int cpu) {
+        if (config_.rt_priority > 0 || cpu >= 0) {
+            std::string report = std::string("RT: ") + name + " thread";
+            std::string result;
+            if (config_.rt_priority > 0) {
+                RtSched::set_priority(config_.rt_priority, config_.rt_round_robin, result);
+                report += " " + result;
+            }
+            if (cpu >= 0) {
+                RtSched::pin_cpu(cpu, result);
+                report += (config_.rt_priority > 0 ? ", " : " ") + result;
+            }
+            std::cerr << report << std::endl;
+        }
+        if (config_.rt_mlock) {
+            RtSched::prefault_stack();
+            {
+                std::lock_guard<std::mutex> lock(rt_mutex_);
+                rt_ready_++;
+            }
+            rt_cv_.notify_all();
+        }
+    }
+    
+    ClientConnection& add_client(int fd) {
+        auto callback = [this](ClientConnection& client, uint8_t port, uint8_t cmd, const std::vector<uint8_t>& data) {
+            handle_kiss_frame(client, port, cmd, data);
+        };
+        
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients_.emplace_back(std::make_unique<ClientConnection>(fd, callback));
+        clients_.back()->id = next_client_id_++;
+        
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->client_count = clients_.size();
+        }
+#endif
+        return *clients_.back();
+    }
+    
+    // Same KISS service on a filesystem socket for colocated clients, no
+    // TCP/IP stack in the way
+    void open_unix_socket() {
+        struct sockaddr_un addr;
+        if (config_.unix_socket.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Unix socket path too long: " + config_.unix_socket);
+        }
+        
+        unix_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (unix_fd_ < 0) {
+            throw std::runtime_error("Failed to create Unix socket");
+        }
+        
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, config_.unix_socket.c_str(), config_.unix_socket.size());
+        
+        // Stale socket file from an earlier run
+        std::remove(config_.unix_socket.c_str());
+        
+        if (bind(unix_fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(unix_fd_, 5) < 0) {
+            WIN_CLOSE_SOCKET(unix_fd_);
+            unix_fd_ = -1;
+            throw std::runtime_error("Failed to listen on " + config_.unix_socket);
+        }
+        
+        u_long nb = 1; ioctlsocket(unix_fd_, FIONBIO, &nb);
+        std::cerr << "KISS TNC listening on " << config_.unix_socket << std::endl;
+    }
+    
+    // The shared-memory rings behave like one permanently connected client
+    void open_shm_transport() {
+        shm_ = std::make_unique<ShmRing::Transport>();
+        if (!shm_->create(config_.shm_name)) {
+            shm_.reset();
+            throw std::runtime_error("Failed to create shared memory transport " + config_.shm_name);
+        }
+        ClientConnection& client = add_client(-1);
+        client.shm = shm_.get();
+        shm_thread_ = std::thread(&KISSTNC::shm_loop, this, &client);
+        std::cerr << "KISS TNC shared memory transport: " << config_.shm_name << std::endl;
+    }
+    
+    // Services the shared-memory client: sleeps on the TNC's bell until
+    // the client writes a frame or frees space for our output
+    void shm_loop(ClientConnection* client) {
+        uint8_t buf[4096];
+        while (g_running) {
+            uint32_t seen = shm_->bell();
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                if (shm_->new_session()) {
+                    // Nothing of the previous client's frames carries over
+                    client->parser.reset();
+                    std::lock_guard<std::mutex> wlock(client->write_mutex);
+                    client->write_buffer.clear();
+                    ui_log("Client attached: shared memory " + config_.shm_name);
                 }
-                if (g_verbose) {
-                    std::cerr << packet_visualize(frame_data.data(), frame_data.size(), true, config_.fragmentation_enabled) << std::endl;
+                size_t n;
+                while ((n = shm_->rx().read(buf, sizeof(buf))) > 0) {
+                    client->parser.process(buf, n);
                 }
-                tx_queue_.push(frame_data);
-#ifdef WITH_UI
-                if (g_ui_state) {
-                    g_ui_state->tx_queue_size = tx_queue_.size();
+                client->flush();
+            }
+            shm_->wait(seen, CLIENT_POLL_MS);
+        }
+    }
+    
+    // Sleep until a socket is readable or the poll interval passes
+    void wait_for_clients() {
+        std::vector<struct pollfd> fds;
+        fds.push_back({static_cast<decltype(pollfd::fd)>(server_fd_), POLLIN, 0});
+        if (unix_fd_ >= 0) {
+            fds.push_back({static_cast<decltype(pollfd::fd)>(unix_fd_), POLLIN, 0});
+        }
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            for (auto& client : clients_) {
+                if (!client->shm) {
+                    fds.push_back({static_cast<decltype(pollfd::fd)>(client->fd), POLLIN, 0});
                 }
-#endif
             }
+        }
+        poll(fds.data(), fds.size(), CLIENT_POLL_MS);
+    }
+    
+    // Runs on the client loop with clients_mutex_ held
+    void handle_kiss_frame(ClientConnection& client, uint8_t port, uint8_t cmd, const std::vector<uint8_t>& data) {
+        if (cmd == KISS::CMD_DATA) {
+            if (g_verbose) {
+                std::cerr << kiss_frame_visualize(data.data(), data.size()) << std::endl;
+            }
+            enqueue(data, TxAck(), tx_flow(client, port));
+        } else if (cmd == KISS::CMD_ACKMODE) {
+            if (data.size() < 3) return;
+            TxAck ack;
+            ack.client = client.id;
+            ack.port = port;
+            ack.id = (data[0] << 8) | data[1];
+            std::vector<uint8_t> payload(data.begin() + 2, data.end());
+            if (g_verbose) {
+                std::cerr << "ACKMODE frame, id " << ack.id << std::endl;
+                std::cerr << kiss_frame_visualize(payload.data(), payload.size()) << std::endl;
+            }
+            enqueue(payload, ack, tx_flow(client, port));
         } else {
             switch (cmd) {
             case KISS::CMD_TXDELAY:
@@ -452,6 +753,7 @@ private:
                 }
                 break;
             case KISS::CMD_SETHW:
+                handle_sethw(client, port, data);
                 break;
             case KISS::CMD_RETURN:
                 break;
@@ -463,85 +765,527 @@ private:
         }
     }
     
-    void tx_loop() {
-        tx_running_ = true;
+    // DRR flow of a client's frames on one KISS port
+    TxFlow tx_flow(const ClientConnection& client, uint8_t port) const {
+        TxFlow flow;
+        flow.id = (client.id << 4) | (port & 0x0F);
+        auto it = config_.tx_weights.find(port);
+        if (it != config_.tx_weights.end()) flow.weight = it->second;
+        return flow;
+    }
+    
+    // Airtime of a queued frame in the current mode (Modes::info follows
+    // the modem's frame setup): a whole OFDM frame, or its share of one 
+    // when frames are aggregated
+    float frame_airtime(size_t bytes) const {
+        Modes::Info info;
+        if (!Modes::info(modem_config_.oper_mode, info)) return 1.0f;
+        if (!aggregation_active() || bytes == SIZE_MAX) return info.duration;
+        float share = float(bytes + Ext::ENTRY_HEADER_SIZE) / info.data_bytes;
+        return info.duration * std::min(1.0f, share);
+    }
+    
+    // Text commands; FILTER sets the client's RX subscription (RxFilter)
+    // and is answered with "FILTER OK" or "FILTER ERR <reason>"
+    void handle_sethw(ClientConnection& client, uint8_t port, const std::vector<uint8_t>& data) {
+        std::string command(data.begin(), data.end());
+        std::string error;
+        if (command.compare(0, 6, "FILTER") != 0) {
+            if (g_verbose) {
+                std::cerr << "Unknown SETHW command: " << command << std::endl;
+            }
+            return;
+        }
         
-        // Random number generator for CSMA
-        std::random_device rd;
-        std::mt19937 gen(rd());
+        bool ok = client.filter.apply(command, error);
+        ui_log("Client " + std::to_string(client.id) + ": " + command + (ok ? "" : " (" + error + ")"));
         
-        while (tx_running_ && g_running) {
-            std::vector<uint8_t> frame;
-            if (tx_queue_.pop(frame)) {
+        std::string reply = ok ? "FILTER OK" : "FILTER ERR " + error;
+        client.send(KISSParser::wrap(std::vector<uint8_t>(reply.begin(), reply.end()), port, KISS::CMD_SETHW));
+    }
+    
+    // ack, if requested, is sent once the whole packet has been on air (for
+    // ARQ packets: once the peer confirmed it). False if the packet was
+    // dropped right away; ack then never fires.
+    bool enqueue(const std::vector<uint8_t>& data, const TxAck& ack = TxAck(), const TxFlow& flow = TxFlow()) {
+        // ACKMODE frames are exempt: their client tracks each one and may
+        // resend on purpose. A payload counts as sent once it is queued.
+        bool dedup = config_.dedup_tx && !ack.client;
+        if (dedup && tx_dups_.seen(data.data(), data.size())) {
+            ui_log("TX: Duplicate of a recent frame dropped (" + std::to_string(data.size()) + " bytes)");
+#ifdef WITH_UI
+            if (g_ui_state) g_ui_state->tx_duplicates++;
+#endif
+            return false;
+        }
+        
+        size_t max_payload = payload_size_ - 2;
+        bool queued;
+        size_t count = 1;
+        
+        // Fountain coding only while every station heard can decode it,
+        // else the packet is fragmented as usual
+        if (config_.bulk_threshold > 0 && data.size() >= config_.bulk_threshold && data.size() > max_payload &&
+            peers_.all_capable(Ext::CAP_BULK)) {
+            bool accepted = enqueue_bulk(data, ack);
+            if (accepted && dedup) tx_dups_.remember(data.data(), data.size());
+            return accepted;
+        }
+        
+        // Compression only saves airtime if it avoids fragments or lets
+        // more frames share one OFDM frame
+        std::vector<uint8_t> packed;
+        bool compressed = compression_active() &&
+                          (data.size() > max_payload || aggregation_active()) &&
+                          compress_payload(data, packed);
+        
+        if (compressed && packed.size() + Ext::HEADER_SIZE <= max_payload) {
+            if (g_verbose) {
+                std::cerr << "TX: Compressed " << data.size() << " -> " << packed.size() << " bytes" << std::endl;
+            }
+            queued = tx_queue_.push(std::move(packed), Ext::ENTRY_COMPRESSED, ack, flow);
+        } else if (config_.fragmentation_enabled && fragmenter_.needs_fragmentation(data.size(), max_payload)) {
+            const auto& source = compressed ? packed : data;
+            auto fragments = fragmenter_.fragment(source, max_payload);
+            if (compressed) {
+                for (auto& frag : fragments) frag[4] |= Frag::FLAG_COMPRESSED;
+            }
+            ui_log("TX: Fragmenting " + std::to_string(source.size()) + " bytes" +
+                   (compressed ? " (compressed from " + std::to_string(data.size()) + ")" : "") +
+                   " into " + std::to_string(fragments.size()) + " fragments");
+            if (g_verbose) {
+                for (auto& frag : fragments) {
+                    std::cerr << packet_visualize(frag.data(), frag.size(), true, true) << std::endl;
+                }
+            }
+            count = fragments.size();
+            std::vector<std::vector<uint8_t>> window;
+            if (arq_active() && arq_.start(fragments, flow, window)) {
+                uint16_t packet_id = (fragments[0][1] << 8) | fragments[0][2];
+                count = window.size();
+                queued = tx_queue_.push_batch(std::move(window), false, 0, TxAck(), flow);
+                if (!queued) {
+                    arq_.abort(packet_id);
+                } else if (ack.client) {
+                    std::lock_guard<std::mutex> lock(control_mutex_);
+                    arq_acks_[packet_id] = ack;
+                }
+            } else {
+                queued = tx_queue_.push_batch(std::move(fragments), false, 0, ack, flow);
+            }
+        } else {
+            std::vector<uint8_t> frame_data = data;
+            if (frame_data.size() > max_payload) {
+                std::cerr << "Warning: Frame too large (" << frame_data.size() 
+                          << " > " << max_payload << "), truncating" << std::endl;
+                frame_data.resize(max_payload);
+            }
+            if (g_verbose) {
+                std::cerr << packet_visualize(frame_data.data(), frame_data.size(), true, config_.fragmentation_enabled) << std::endl;
+            }
+            queued = tx_queue_.push(std::move(frame_data), 0, ack, flow);
+        }
+        
+        if (queued && dedup) {
+            tx_dups_.remember(data.data(), data.size());
+        } else if (!queued) {
+            ui_log("TX: Queue full, dropped " + std::to_string(count) + " frame(s) (" +
+                   std::to_string(tx_queue_.size()) + " queued, " +
+                   std::to_string(tx_queue_.bytes()) + " bytes)");
+        }
+        publish_queue_stats();
+        return queued;
+    }
+    
+    bool compress_payload(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = Compress::compress(data.data(), data.size(), out);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->compress_frames++;
+            g_ui_state->compress_bytes_in += data.size();
+            g_ui_state->compress_bytes_out += ok ? out.size() : data.size();
+            g_ui_state->compress_time_us += us;
+        }
+#else
+        (void)us;
+#endif
+        return ok;
+    }
+    
+    bool decompress_payload(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, const std::string& call) {
+        if (Compress::decompress(in.data(), in.size(), out, Compress::MAX_OUTPUT)) {
+            return true;
+        }
+        ui_log("RX: Corrupt compressed payload from " + call);
 #ifdef WITH_UI
-                if (g_ui_state) {
-                    g_ui_state->tx_queue_size = tx_queue_.size();
+        if (g_ui_state) g_ui_state->rx_error_count++;
+#endif
+        return false;
+    }
+    
+    // Bulk objects are sent as fountain symbols in the base mode, one
+    // object at a time, whenever the TX queue is idle. The queue holds at
+    // most BULK_MAX_OBJECTS objects and the TX queue's byte limit; objects
+    // still waiting when the TTL runs out are dropped. The encoder is built
+    // on the TX thread when an object's turn comes, not on the client loop.
+    bool enqueue_bulk(const std::vector<uint8_t>& data, const TxAck& ack) {
+        if (data.size() > Fountain::MAX_OBJECT_BYTES) {
+            ui_log("TX: Bulk object of " + std::to_string(data.size()) + " bytes too large, dropped");
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(bulk_mutex_);
+        size_t max_bytes = std::max(config_.tx_queue_max_bytes, 0);
+        if (bulk_tx_.size() >= BULK_MAX_OBJECTS || (max_bytes && bulk_bytes_ + data.size() > max_bytes)) {
+            ui_log("TX: Bulk queue full, dropped " + std::to_string(data.size()) + " byte object (" +
+                   std::to_string(bulk_tx_.size()) + " objects, " + std::to_string(bulk_bytes_) + " bytes queued)");
+            return false;
+        }
+        BulkObject bulk;
+        bulk.data = data;
+        bulk.ack = ack;
+        bulk.enqueued = std::chrono::steady_clock::now();
+        bulk_bytes_ += data.size();
+        bulk_tx_.push_back(std::move(bulk));
+        return true;
+    }
+    
+    // ack is set with the object's last frame. TX thread only: the object
+    // being sent lives in bulk_current_, out of the queue and its lock.
+    bool next_bulk_frame(std::vector<uint8_t>& framed, TxAck& ack) {
+        std::vector<uint8_t> body;
+        ack = TxAck();
+        while (true) {
+            if (!bulk_current_.encoder && !start_next_bulk()) return false;
+            
+            auto& enc = *bulk_current_.encoder;
+            if (enc.next(body)) {
+                framed = Ext::header(local_caps(), Ext::TYPE_FOUNTAIN);
+                framed.insert(framed.end(), body.begin(), body.end());
+                if (enc.frames_sent() == enc.frames_total()) {
+                    ack = bulk_current_.ack;
+                }
+                return true;
+            }
+            ui_log("TX: Bulk object " + std::to_string(enc.object_id()) + " sent (" +
+                   std::to_string(enc.frames_sent()) + " frames)");
+            bulk_current_ = BulkObject();
+        }
+    }
+    
+    // Takes the next unexpired object off the queue and builds its encoder
+    bool start_next_bulk() {
+        BulkObject bulk;
+        std::vector<TxAck> lost;
+        {
+            std::lock_guard<std::mutex> lock(bulk_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            while (true) {
+                if (bulk_tx_.empty()) break;
+                bulk = std::move(bulk_tx_.front());
+                bulk_tx_.pop_front();
+                bulk_bytes_ -= bulk.data.size();
+                if (config_.tx_frame_ttl_ms <= 0 ||
+                    now - bulk.enqueued <= std::chrono::milliseconds(config_.tx_frame_ttl_ms)) {
+                    break;
                 }
+                ui_log("TX: Dropping " + std::to_string(bulk.data.size()) + " byte bulk object, TTL expired");
+                tx_queue_.count_expired();
+                lost.push_back(bulk.ack);
+                bulk = BulkObject();
+            }
+        }
+        for (const auto& ack : lost) drop_ack(ack);
+        if (bulk.data.empty()) return false;
+        
+        size_t symbol_size = payload_size_ - Ext::HEADER_SIZE - Fountain::HEADER_SIZE;
+        bulk.encoder = std::make_unique<FountainEncoder>(next_object_id_++, std::move(bulk.data),
+                                                         symbol_size, config_.bulk_overhead);
+        bulk.data = std::vector<uint8_t>();
+        ui_log("TX: Bulk object " + std::to_string(bulk.encoder->object_id()) + ", " +
+               std::to_string(bulk.encoder->object_size()) + " bytes in " +
+               std::to_string(bulk.encoder->symbols()) + " symbols, " +
+               std::to_string(bulk.encoder->frames_total()) + " frames");
+        bulk_current_ = std::move(bulk);
+        return true;
+    }
+    
+    void publish_queue_stats() {
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->tx_queue_size = tx_queue_.size();
+            g_ui_state->tx_queue_dropped = tx_queue_.dropped_full();
+            g_ui_state->tx_queue_expired = tx_queue_.dropped_expired();
+            int p50, p90, p99;
+            tx_queue_.age_percentiles(p50, p90, p99);
+            g_ui_state->tx_queue_age_p50 = p50;
+            g_ui_state->tx_queue_age_p90 = p90;
+            g_ui_state->tx_queue_age_p99 = p99;
+        }
 #endif
-                // Wait for TX lockout to clear 
-                if (!is_tx_allowed()) {
-                    std::cerr << "TX: Waiting for lockout to clear..." << std::endl;
-                    wait_for_tx_allowed();
+    }
+    
+    void tx_loop() {
+        tx_running_ = true;
+        apply_rt_settings("TX", config_.tx_cpu);
+        
+        // Random number generator for CSMA
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        
+        while (tx_running_ && g_running) {
+            service_arq();
+            for (const auto& ack : tx_queue_.take_lost_acks()) drop_ack(ack);
+            
+            TxFrame frame;
+            TxAck bulk_ack;
+            std::vector<uint8_t> control;
+            if (serve_scheduled()) {
+                continue;
+            } else if (pop_control(control)) {
+                wait_for_channel(gen);
+                transmit(control, modem_config_.oper_mode);
+            } else if (tx_queue_.pop(frame)) {
+                publish_queue_stats();
+                wait_for_channel(gen);
+                
+                // Don't spend airtime on frames the application has given up on
+                if (tx_queue_.expire(frame)) {
+                    ui_log("TX: Dropping " + std::to_string(frame.data.size()) + 
+                           " byte frame, TTL expired while waiting for channel");
+                    drop_ack(frame.ack);
+                    publish_queue_stats();
+                    continue;
                 }
                 
-                // CSMA
-                if (config_.csma_enabled) {
-                    int backoff_count = 0;
-                    
-                    while (backoff_count < config_.max_backoff_slots) {
-                        // Re-check lockout after backoff
-                        if (!is_tx_allowed()) {
-                            wait_for_tx_allowed();
-                        }
-                        
-                        // Check carrier
-                        float level_db = audio_->measure_level(config_.carrier_sense_ms);
-                        bool is_busy = (level_db > config_.carrier_threshold_db);
-                        
-                        if (is_busy) {
-                            // Channel busy - wait
-                            std::uniform_int_distribution<> slots_dist(1, 
-                                std::min(1 << backoff_count, config_.max_backoff_slots));
-                            int slots = slots_dist(gen);
-                            int wait_ms = slots * config_.slot_time_ms;
-                            
-                            std::cerr << "CSMA: Channel busy (" << level_db << " dB > " 
-                                      << config_.carrier_threshold_db << " dB), backing off " 
-                                      << slots << " slots (" << wait_ms << " ms)" << std::endl;
-                            
-                            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
-                            backoff_count++;
-                        } else {
-                            // Channel clear - apply p-persistence
-                            std::uniform_int_distribution<> p_dist(0, 255);
-                            if (p_dist(gen) < config_.p_persistence) {
-                                std::cerr << "CSMA: Channel clear (" << level_db << " dB), transmitting" << std::endl;
-                                break;
-                            } else {
-                                std::cerr << "CSMA: Channel clear but deferring (p=" 
-                                          << config_.p_persistence << "/255)" << std::endl;
-                                std::this_thread::sleep_for(
-                                    std::chrono::milliseconds(config_.slot_time_ms));
-                            }
-                        }
-                    }
-                    
-                    if (backoff_count >= config_.max_backoff_slots) {
+                size_t frame_count;
+                int mode;
+                std::vector<TxAck> acks;
+                auto framed = build_tx_frame(frame, frame_count, mode, acks);
+                if (frame_count > 1) {
+                    publish_queue_stats();
+                }
+                transmit(framed, mode);
+                for (const auto& ack : acks) send_ack(ack);
+            } else if (next_bulk_frame(control, bulk_ack)) {
+                wait_for_channel(gen);
+                transmit(control, modem_config_.oper_mode);
+                send_ack(bulk_ack);
+            } else if (hello_due()) {
+                wait_for_channel(gen);
+                send_hello();
+            } else {
+                std::this_thread::sleep_until(std::min(std::chrono::steady_clock::now() + std::chrono::milliseconds(10),
+                                                       next_scheduled()));
+            }
+        }
+    }
+    
+    // Blocks until the TX lockout has cleared and CSMA allows keying up.
+    //
+    // CSMA follows 802.11 DCF, driven by the carrier state the RX thread
+    // publishes with every block. A busy period draws a backoff of 1..CW
+    // slots (CW doubling per busy period, up to max_backoff_slots); the
+    // backoff only counts down through slots the channel stays idle for and
+    // freezes while it is busy. Once it is spent, p-persistence decides at
+    // each slot boundary. The TX thread keeps listening throughout.
+    //
+    // Busy freezes the countdown at once, but counts as a new busy period
+    // only after a quarter slot, and the channel is idle again only after a
+    // quarter slot of quiet, so a flickering carrier is one busy period.
+    // A channel that never clears is given up on after max_backoff_slots
+    // full contention windows. Scheduled frames that fall due meanwhile
+    // are sent from here, they don't wait for the channel.
+    void wait_for_channel(std::mt19937& gen) {
+        // Wait for TX lockout to clear 
+        if (!is_tx_allowed()) {
+            std::cerr << "TX: Waiting for lockout to clear..." << std::endl;
+            wait_for_tx_allowed();
+        }
+        
+        using Clock = std::chrono::steady_clock;
+        csma_clear_at_ = Clock::now();
+        if (!config_.csma_enabled) return;
+        
+        const auto slot = std::chrono::milliseconds(std::max(config_.slot_time_ms, 1));
+        const auto dwell = std::max(slot / 4, std::chrono::milliseconds(1));
+        const int max_cw = std::max(config_.max_backoff_slots, 1);
+        std::uniform_int_distribution<> p_dist(0, 255);
+        int cw = 1;              // contention window in slots
+        int backoff = 0;         // idle slots left before p-persistence
+        int busy_periods = 0;
+        bool was_busy = false;   // after hysteresis
+        bool counted = false;    // this busy period has drawn its backoff
+        bool decide_now = true;  // a clear channel at the start needs no idle slot
+        auto slot_start = Clock::now();
+        auto busy_since = slot_start;
+        auto last_busy = slot_start - dwell;
+        auto give_up_at = slot_start + slot * max_cw * max_cw;
+        
+        while (tx_running_ && g_running) {
+            if (!is_tx_allowed()) {
+                auto paused = Clock::now();
+                wait_for_tx_allowed();
+                slot_start = Clock::now();
+                give_up_at += slot_start - paused;
+                csma_clear_at_ = slot_start;
+            }
+            
+            auto before = Clock::now();
+            if (serve_scheduled()) {
+                // Our own airtime doesn't count, listen afresh
+                slot_start = Clock::now();
+                give_up_at += slot_start - before;
+                csma_clear_at_ = slot_start;
+                decide_now = false;
+                continue;
+            }
+            
+            float level_db = 0, threshold_db = 0;
+            bool dcd = false;
+            bool busy = channel_busy(level_db, threshold_db, dcd);
+            auto now = Clock::now();
+            
+            if (now >= give_up_at) {
+                count_csma_decision();
+                std::cerr << "CSMA: Channel not clear for " << (slot * max_cw * max_cw).count() 
+                          << " ms, transmitting anyway" << std::endl;
+                return;
+            }
+            
+            if (busy) last_busy = now;
+            if (busy || now - last_busy < dwell) {
+                if (!was_busy) {
+                    was_busy = true;
+                    counted = false;
+                    busy_since = now;
+                }
+                if (!counted && now - busy_since >= dwell) {
+                    counted = true;
+                    count_csma_decision();
+                    if (++busy_periods > config_.max_backoff_slots) {
                         std::cerr << "CSMA: Max backoff reached, transmitting anyway" << std::endl;
+                        return;
+                    }
+                    if (backoff == 0) {
+                        cw = std::min(cw * 2, max_cw);
+                        backoff = std::uniform_int_distribution<>(1, cw)(gen);
                     }
+                    std::cerr << "CSMA: Channel busy (";
+                    if (dcd && config_.csma_detect != CsmaDetect::ENERGY) {
+                        std::cerr << "DCD, metric " << decoder_->timing_metric();
+                    } else {
+                        std::cerr << level_db << " dB > " << threshold_db << " dB";
+                    }
+                    std::cerr << "), backoff " << backoff << " idle slots (CW " << cw << ")" << std::endl;
+                }
+                decide_now = false;
+                wait_channel_event(std::min({now + dwell, give_up_at, next_scheduled()}));
+                continue;
+            }
+            
+            if (was_busy) {
+                // Idle again: a full slot of quiet, counted from the last
+                // busy block, before counting down
+                was_busy = false;
+                slot_start = last_busy;
+                csma_clear_at_ = last_busy;
+            }
+            
+            if (decide_now || now >= slot_start + slot) {
+                if (!decide_now) {
+                    slot_start = now - slot_start < 2 * slot ? slot_start + slot : now;
+                    if (backoff > 0) backoff--;
                 }
+                decide_now = false;
                 
-                transmit(frame);
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                if (backoff == 0) {
+                    count_csma_decision();
+                    if (p_dist(gen) < config_.p_persistence) {
+                        std::cerr << "CSMA: Channel clear (" << level_db << " dB), transmitting" << std::endl;
+                        return;
+                    }
+                    std::cerr << "CSMA: Channel clear but deferring (p=" 
+                              << config_.p_persistence << "/255)" << std::endl;
+                }
             }
+            wait_channel_event(std::min({slot_start + slot, give_up_at, next_scheduled()}));
+        }
+    }
+    
+    bool channel_busy(float& level_db, float& threshold_db, bool& dcd) {
+        level_db = carrier_.level_db();
+        threshold_db = busy_threshold_db();
+        dcd = decoder_->carrier_detected();
+        bool energy_busy = level_db > threshold_db;
+        return config_.csma_detect == CsmaDetect::ENERGY ? energy_busy
+             : config_.csma_detect == CsmaDetect::DCD ? dcd
+             : energy_busy || dcd;
+    }
+    
+    // Counts a CSMA decision, and whether it rested on a stale level
+    void count_csma_decision() {
+        csma_checks_++;
+        if (carrier_.stale()) {
+            csma_stale_++;
+            if (g_verbose) std::cerr << "CSMA: Carrier level is stale, RX audio not flowing" << std::endl;
+        }
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->csma_checks = csma_checks_.load();
+            g_ui_state->csma_stale = csma_stale_.load();
+        }
+#endif
+    }
+    
+    // Sleeps until the RX thread publishes a new block or the deadline
+    void wait_channel_event(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(channel_mutex_);
+        uint64_t seq = channel_seq_;
+        channel_cv_.wait_until(lock, deadline, [&] {
+            return channel_seq_ != seq || !tx_running_ || !g_running;
+        });
+    }
+    
+    // Called when the transmitter keys up: time since CSMA last saw the
+    // channel go (or found it) clear. Only for frames that went through
+    // wait_for_channel(), scheduled frames skip CSMA.
+    void note_keyed() {
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - csma_clear_at_).count();
+        csma_keyed_++;
+        csma_key_total_ms_ += ms;
+        csma_key_max_ms_ = std::max(csma_key_max_ms_, ms);
+        if (g_verbose) std::cerr << "CSMA: Keyed " << static_cast<int>(ms) << " ms after channel clear" << std::endl;
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->csma_key_avg_ms = static_cast<float>(csma_key_total_ms_ / csma_keyed_);
+            g_ui_state->csma_key_max_ms = static_cast<float>(csma_key_max_ms_);
+        }
+#endif
+    }
+    
+    // Level above which CSMA calls the channel busy: the configured
+    // threshold, or the tracked noise floor plus margin once it has settled
+    float busy_threshold_db() const {
+        if (config_.csma_auto_threshold && noise_.ready()) {
+            return noise_.floor_db() + config_.csma_margin_db;
         }
+        return config_.carrier_threshold_db;
     }
     
-    void transmit(const std::vector<uint8_t>& data) {
-        ui_log("TX: " + std::to_string(data.size()) + " bytes");
+    // Sends one OFDM frame, framed_data already carries the length prefix
+    // or extension header. With start_at set, its first sample leaves the
+    // sound card at that time, keying up ahead of it.
+    void transmit(const std::vector<uint8_t>& framed_data, int oper_mode,
+                  std::chrono::steady_clock::time_point start_at = {}) {
+        const bool scheduled = start_at != std::chrono::steady_clock::time_point{};
+        ui_log("TX: " + std::to_string(framed_data.size()) + " bytes");
         if (g_verbose) {
-            std::cerr << packet_visualize(data.data(), data.size(), true, config_.fragmentation_enabled) << std::endl;
+            std::cerr << packet_visualize(framed_data.data(), framed_data.size(), true, false) << std::endl;
         }
         
         if (config_.tx_blanking_enabled) {
@@ -552,19 +1296,16 @@ private:
         if (g_ui_state) {
             g_ui_state->transmitting = true;
             g_ui_state->tx_frame_count++;
-            g_ui_state->add_packet(true, data.size(), 0);  
+            g_ui_state->add_packet(true, framed_data.size(), 0);  
         }
 #endif
         
-        // Add length prefix framing
-        auto framed_data = frame_with_length(data);
-        
         // Encode to audio
         auto samples = encoder_->encode(
             framed_data.data(), framed_data.size(),
             modem_config_.center_freq,
             modem_config_.call_sign,
-            modem_config_.oper_mode
+            oper_mode
         );
         
         if (samples.empty()) {
@@ -578,6 +1319,7 @@ private:
         
         float duration = samples.size() / (float)config_.sample_rate;
         float total_tx_duration = duration;
+        uint64_t underruns = audio_->playback_underruns();
         
         // Handle PTT based on type
         if (config_.ptt_type == PTTType::VOX) {
@@ -600,12 +1342,18 @@ private:
 #ifdef WITH_UI
             if (g_ui_state) g_ui_state->ptt_on = true;
 #endif
+            if (!scheduled) note_keyed();
             
             // Transmit: lead tone -> OFDM data -> tail tone
             const int chunk_size = 1024;
             
             // Lead tone
-            for (size_t i = 0; i < lead_tone.size(); i += chunk_size) {
+            size_t lead_start = 0;
+            if (scheduled) {
+                lead_start = std::min((size_t)chunk_size, lead_tone.size());
+                write_scheduled(lead_tone.data(), (int)lead_start, start_at - tx_lead_time());
+            }
+            for (size_t i = lead_start; i < lead_tone.size(); i += chunk_size) {
                 int n = std::min(chunk_size, (int)(lead_tone.size() - i));
                 audio_->write(lead_tone.data() + i, n);
             }
@@ -622,7 +1370,7 @@ private:
                 audio_->write(tail_tone.data() + i, n);
             }
             
-            audio_->drain_playback();
+            std::this_thread::sleep_until(tx_played_at(audio_->playback_mark()));
             
 #ifdef WITH_UI
             if (g_ui_state) g_ui_state->ptt_on = false;
@@ -634,7 +1382,12 @@ private:
             ui_log("TX: " + std::to_string(samples.size()) + " samples, " + 
                    std::to_string(duration) + " seconds");
             
+            if (scheduled) {
+                std::this_thread::sleep_until(start_at - tx_lead_time());
+            }
+            
             // PTT on (for RIGCTL or COM mode)
+            if (!scheduled) note_keyed();
             if (config_.ptt_type == PTTType::RIGCTL || config_.ptt_type == PTTType::COM
 #ifdef WITH_CM108
                 || config_.ptt_type == PTTType::CM108
@@ -644,33 +1397,47 @@ private:
                 std::this_thread::sleep_for(std::chrono::milliseconds(config_.ptt_delay_ms));
             }
             
-            // Leading silence (TXDelay)
-            audio_->write_silence(config_.tx_delay_ms * config_.sample_rate / 1000);
-            
-            // Transmit audio
+            // Transmit audio, after TXDelay of leading silence or whatever
+            // silence is left until start_at
             const int chunk_size = 1024;
-            for (size_t i = 0; i < samples.size(); i += chunk_size) {
+            size_t data_start = 0;
+            if (scheduled) {
+                data_start = std::min((size_t)chunk_size, samples.size());
+                write_scheduled(samples.data(), (int)data_start, start_at);
+            } else {
+                audio_->write_silence(config_.tx_delay_ms * config_.sample_rate / 1000);
+            }
+            for (size_t i = data_start; i < samples.size(); i += chunk_size) {
                 int n = std::min(chunk_size, (int)(samples.size() - i));
                 audio_->write(samples.data() + i, n);
             }
             
-            // Trailing silence
-            audio_->write_silence(config_.ptt_tail_ms * config_.sample_rate / 1000);
-            audio_->drain_playback();
-            
-            // PTT off
+            // PTT off ptt_tail_ms after the last sample has left the sound
+            // card, as reported by the playback callback
+            auto played = tx_played_at(audio_->playback_mark());
             if (config_.ptt_type == PTTType::RIGCTL || config_.ptt_type == PTTType::COM
 #ifdef WITH_CM108
                 || config_.ptt_type == PTTType::CM108
 #endif
             ) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(config_.ptt_tail_ms));
+                std::this_thread::sleep_until(played + std::chrono::milliseconds(config_.ptt_tail_ms));
                 set_ptt(false);
+            } else {
+                std::this_thread::sleep_until(played);
             }
         }
         
         tx_blanking_active_ = false;
         
+        // Playback ran dry mid-frame: the peer got a gap of silence
+        if (audio_->playback_underruns() != underruns) {
+            ui_log("TX: Playback underrun, frame went out with a gap");
+            tx_underrun_frames_++;
+#ifdef WITH_UI
+            if (g_ui_state) g_ui_state->tx_underrun_frames++;
+#endif
+        }
+        
 #ifdef WITH_UI
         if (g_ui_state) {
             g_ui_state->transmitting = false;
@@ -679,6 +1446,25 @@ private:
 #endif
     }
     
+    // When the sample before mark is on air; now if playback stalled
+    std::chrono::steady_clock::time_point tx_played_at(size_t mark) {
+        std::chrono::steady_clock::time_point done;
+        if (!audio_->wait_played(mark, done)) {
+            ui_log("TX: Playback did not complete, releasing PTT");
+        }
+        return done;
+    }
+    
+    // First chunk of a scheduled transmission
+    void write_scheduled(const float* buffer, int frames, std::chrono::steady_clock::time_point when) {
+        size_t mark = audio_->playback_mark();
+        if (!audio_->write_at(buffer, frames, when)) {
+            auto late = std::chrono::duration_cast<std::chrono::milliseconds>(
+                audio_->playback_time(mark) - when).count();
+            ui_log("TX: Scheduled start missed by " + std::to_string(late) + " ms");
+        }
+    }
+    
     // Generate a sine wave tone for VOX triggering
     std::vector<float> generate_tone(int freq_hz, int num_samples, float amplitude = 0.8f) {
         std::vector<float> tone(num_samples);
@@ -696,122 +1482,660 @@ private:
             
             tone[i] = amplitude * envelope * std::sin(phase_inc * i);
         }
-        
-        return tone;
+        
+        return tone;
+    }
+    
+    void rx_loop() {
+        rx_running_ = true;
+        apply_rt_settings("RX", config_.rx_cpu);
+        
+        std::vector<float> buffer(1024);
+        int level_update_counter = 0;
+        const int LEVEL_UPDATE_INTERVAL = 5;
+        
+        // Capture ring position of the decoder's sample 0, maps the sync
+        // position back to when the preamble reached the sound card
+        uint32_t generation = audio_->capture_generation();
+        size_t decoder_base = audio_->capture_position();
+        uint64_t overruns_seen = audio_->capture_overruns();
+        
+        auto frame_callback = [this, &decoder_base](const uint8_t* data, size_t len) {
+            set_tx_lockout(config_.rx_guard_ms / 1000.0f);
+            
+            float snr = decoder_->get_last_snr();
+            std::string call = decoder_->get_last_call_sign();
+            
+            rx_frame_time_ = audio_->capture_time(decoder_base + decoder_->get_last_sync_sample());
+            auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - rx_frame_time_).count();
+            if (g_verbose) {
+                std::cerr << "RX: preamble captured " << latency << " ms before decode" << std::endl;
+            }
+            
+            // Samples went missing between preamble and end of frame: the
+            // CRC passed, but timing and SNR are off
+            size_t frame_start = decoder_base + decoder_->get_last_sync_sample();
+            size_t frame_end = decoder_base + decoder_->get_sample_count();
+            rx_frame_overrun_ = audio_->capture_gap_between(frame_start, frame_end);
+            if (rx_frame_overrun_) {
+                ui_log("RX: Frame from " + call + " spans a capture overrun");
+                rx_overrun_frames_++;
+#ifdef WITH_UI
+                if (g_ui_state) g_ui_state->rx_overrun_frames++;
+#endif
+            }
+            
+#ifdef WITH_UI
+            if (g_ui_state) {
+                g_ui_state->rx_frame_count++;
+                g_ui_state->receiving = false;
+                g_ui_state->last_rx_snr = snr;
+                g_ui_state->rx_latency_ms = static_cast<int>(latency);
+            }
+#endif
+            
+            if (peers_.update_link(call, true, snr, config_.adaptive_margin_db, config_.adaptive_hysteresis_db) &&
+                local_caps() != 0) {
+                // Let a new station learn what we support
+                hello_pending_ = true;
+            }
+            
+            if (Ext::is_ext_frame(data, len)) {
+                handle_ext_frame(data, len, snr, call);
+                return;
+            }
+            
+            auto payload = unframe_length(data, len);
+            
+            if (payload.empty()) {
+                ui_log("RX: Empty payload after unframing");
+#ifdef WITH_UI
+                if (g_ui_state) g_ui_state->rx_error_count++;
+#endif
+                return;
+            }
+            
+            handle_rx_payload(payload, snr, call);
+        };
+        
+        bool was_blanking = false;
+        
+        while (rx_running_ && g_running) {
+            int n = audio_->read(buffer.data(), buffer.size());
+            if (n > 0) {
+                uint64_t overruns = audio_->capture_overruns();
+                if (overruns != overruns_seen) {
+                    ui_log("Audio: Capture overrun, " + std::to_string(overruns - overruns_seen) +
+                           " callback(s) cut short, " + std::to_string(audio_->capture_lost()) + " samples lost in total");
+                    overruns_seen = overruns;
+                }
+                
+                // Reconnected: positions restarted, the decoder's half
+                // frames belong to the old stream
+                if (audio_->capture_generation() != generation) {
+                    generation = audio_->capture_generation();
+                    decoder_->reset();
+                    size_t position = audio_->capture_position();
+                    decoder_base = position >= static_cast<size_t>(n) ? position - n : 0;
+                }
+                
+                bool blanking = tx_blanking_active_.load();
+                
+                if (blanking) {
+                    was_blanking = true;
+                } else {
+                    if (was_blanking) {
+                        decoder_->reset();
+                        decoder_base = audio_->capture_position() - n;
+                        was_blanking = false;
+                    }
+                    decoder_->process(buffer.data(), n, frame_callback);
+                    extend_tx_lockout(decoder_->carrier_detected());
+                }
+                carrier_.feed(buffer.data(), n);
+                {
+                    std::lock_guard<std::mutex> lock(channel_mutex_);
+                    channel_seq_++;
+                }
+                channel_cv_.notify_all();
+                // Only quiet channel goes into the floor: not our own
+                // transmission, not frames the decoder is working on
+                if (!blanking && !decoder_->carrier_detected()) {
+                    noise_.feed(carrier_.level_db(), n);
+                }
+                
+#ifdef WITH_UI
+                if (g_ui_state && ++level_update_counter >= LEVEL_UPDATE_INTERVAL) {
+                    level_update_counter = 0;
+                    
+                    // Same level CSMA compares against the threshold
+                    g_ui_state->update_level(carrier_.level_db());
+                    g_ui_state->dcd = decoder_->carrier_detected();
+                    g_ui_state->noise_floor_db = noise_.ready() ? noise_.floor_db() : -100.0f;
+                    g_ui_state->busy_threshold_db = busy_threshold_db();
+                    
+                    // Copy decoder stats
+                    if (g_ui_state->stats_reset_requested.exchange(false)) {
+                        decoder_->stats_sync_count = 0;
+                        decoder_->stats_preamble_errors = 0;
+                        decoder_->stats_symbol_errors = 0;
+                        decoder_->stats_crc_errors = 0;
+                        audio_->reset_stats();
+                        overruns_seen = 0;
+                    }
+                    g_ui_state->audio_overruns = audio_->capture_overruns();
+                    g_ui_state->audio_lost = audio_->capture_lost();
+                    g_ui_state->audio_underruns = audio_->playback_underruns();
+                    g_ui_state->audio_padded = audio_->playback_padded();
+                    g_ui_state->sync_count = decoder_->stats_sync_count;
+                    g_ui_state->preamble_errors = decoder_->stats_preamble_errors;
+                    g_ui_state->symbol_errors = decoder_->stats_symbol_errors;
+                    g_ui_state->crc_errors = decoder_->stats_crc_errors;
+                }
+#endif
+            }
+        }
+    }
+    
+    void handle_ext_frame(const uint8_t* data, size_t len, float snr, const std::string& call) {
+        uint8_t caps = data[3];
+        uint8_t type = data[4];
+        peers_.set_caps(call, caps);
+        
+        switch (type) {
+        case Ext::TYPE_HELLO:
+            ui_log("RX: Hello from " + call + " (caps 0x" + to_hex(caps) + ")");
+            break;
+        case Ext::TYPE_AGGREGATE: {
+            std::vector<Ext::Entry> entries;
+            if (!Ext::split_entries(data + Ext::HEADER_SIZE, len - Ext::HEADER_SIZE, entries)) {
+                ui_log("RX: Malformed aggregate frame from " + call);
+#ifdef WITH_UI
+                if (g_ui_state) g_ui_state->rx_error_count++;
+#endif
+                break;
+            }
+            if (g_verbose) {
+                std::cerr << "RX: Aggregate of " << entries.size() << " frames from " << call << std::endl;
+            }
+            for (auto& entry : entries) {
+                if (entry.flags & Ext::ENTRY_HDRCOMP) {
+                    bool nack;
+                    if (!hdr_rx_.decompress(call, entry.data, nack)) {
+                        ui_log("RX: Unknown header context from " + call + ", packet dropped");
+                        if (nack) send_hc_nack(call, entry.data[HdrComp::CID_OFFSET], entry.data[HdrComp::CID_OFFSET + 1]);
+                        continue;
+                    }
+                }
+                if (entry.flags & Ext::ENTRY_COMPRESSED) {
+                    std::vector<uint8_t> plain;
+                    if (!decompress_payload(entry.data, plain, call)) continue;
+                    entry.data = std::move(plain);
+                }
+                handle_rx_payload(entry.data, snr, call);
+            }
+            break;
+        }
+        case Ext::TYPE_ARQ_STATUS: {
+            Arq::Status status;
+            if (!Arq::decode_status(data + Ext::HEADER_SIZE, len - Ext::HEADER_SIZE, status)) {
+                ui_log("RX: Malformed ARQ status from " + call);
+                break;
+            }
+            if (status.to != modem_config_.call_sign) break;
+            handle_arq_status(status, call);
+            break;
+        }
+        case Ext::TYPE_HC_NACK:
+            if (len - Ext::HEADER_SIZE >= HdrComp::NACK_SIZE &&
+                Ext::get_call(data + Ext::HEADER_SIZE) == modem_config_.call_sign) {
+                const uint8_t* body = data + Ext::HEADER_SIZE + Ext::CALL_SIZE;
+                if (g_verbose) {
+                    std::cerr << "RX: Header context " << (int)body[0] << " unknown to " << call << std::endl;
+                }
+                hdr_tx_.nack(body[0], body[1]);
+            }
+            break;
+        case Ext::TYPE_FOUNTAIN: {
+            std::vector<uint8_t> object;
+            size_t rank = 0, symbols = 0;
+            auto result = bulk_rx_.process(call, data + Ext::HEADER_SIZE, len - Ext::HEADER_SIZE,
+                                           object, rank, symbols);
+            if (result == FountainReceiver::Result::COMPLETE) {
+                ui_log("RX: Bulk object from " + call + " decoded, " + std::to_string(object.size()) + " bytes");
+                deliver_to_clients(object, snr, true, call);
+            } else if (result == FountainReceiver::Result::PROGRESS && g_verbose) {
+                std::cerr << "RX: Bulk object from " << call << ", " << rank << "/" << symbols 
+                          << " symbols" << std::endl;
+            }
+            break;
+        }
+        default:
+            if (g_verbose) {
+                std::cerr << "RX: Unknown extension type 0x" << std::hex << (int)type << std::dec 
+                          << " from " << call << std::endl;
+            }
+        }
+    }
+    
+    void handle_rx_payload(const std::vector<uint8_t>& payload, float snr, const std::string& call) {
+        if (config_.fragmentation_enabled && reassembler_.is_fragment(payload)) {
+            if (g_verbose) {
+                std::cerr << packet_visualize(payload.data(), payload.size(), false, true) << std::endl;
+            }
+            
+            uint16_t packet_id = (payload[1] << 8) | payload[2];
+            uint8_t flags = payload[4];
+            bool arq = (flags & Frag::FLAG_ARQ) && (local_caps() & Ext::CAP_ARQ);
+            
+            // Retransmission of a packet already delivered, the sender 
+            // missed our status
+            if (arq && arq_recently_completed(call, packet_id)) {
+                if (flags & Frag::FLAG_POLL) send_arq_status(call, packet_id, true);
+                return;
+            }
+            
+            auto reassembled = reassembler_.process(payload);
+            if (!reassembled.empty() && (flags & Frag::FLAG_COMPRESSED)) {
+                std::vector<uint8_t> plain;
+                if (!decompress_payload(reassembled, plain, call)) return;
+                reassembled = std::move(plain);
+            }
+            if (!reassembled.empty()) {
+                ui_log("RX: Reassembled " + std::to_string(reassembled.size()) + " bytes from fragments");
+                if (arq) {
+                    arq_mark_completed(call, packet_id);
+                    send_arq_status(call, packet_id, true);
+                }
+                deliver_to_clients(reassembled, snr, true, call);
+            } else if (arq && (flags & Frag::FLAG_POLL)) {
+                send_arq_status(call, packet_id, false);
+            }
+        } else {
+            deliver_to_clients(payload, snr, false, call);
+        }
+    }
+    
+    // ACKMODE confirmation to the client that submitted the frame, if it is
+    // still connected
+    void send_ack(const TxAck& ack) {
+        if (!ack.client) return;
+        if (ack.client == TxAck::LOCAL) {
+            if (on_tx_done) on_tx_done(ack);
+            return;
+        }
+        std::vector<uint8_t> id = {static_cast<uint8_t>(ack.id >> 8), static_cast<uint8_t>(ack.id & 0xFF)};
+        auto frame = KISSParser::wrap(id, ack.port, KISS::CMD_ACKMODE);
+        
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (auto& client : clients_) {
+            if (client->id == ack.client) {
+                client->send(frame);
+                break;
+            }
+        }
+    }
+    
+    // The packet behind ack will never be sent. KISS ACKMODE has no negative
+    // reply, the client's own timeout covers it; in-process submitters are
+    // told so they can let go of the request.
+    void drop_ack(const TxAck& ack) {
+        if (ack.client == TxAck::LOCAL && on_tx_dropped) on_tx_dropped(ack);
+    }
+    
+    void deliver_to_clients(const std::vector<uint8_t>& payload, float snr, bool was_reassembled,
+                            const std::string& call) {
+        if (config_.dedup_rx && rx_dups_.check(payload.data(), payload.size())) {
+            if (g_verbose) {
+                std::cerr << "RX: Duplicate " << payload.size() << " bytes from " << call << " suppressed" << std::endl;
+            }
+#ifdef WITH_UI
+            if (g_ui_state) g_ui_state->rx_duplicates++;
+#endif
+            return;
+        }
+        
+        ui_log("RX: " + std::to_string(payload.size()) + " bytes, SNR=" + 
+               std::to_string((int)snr) + "dB" + (was_reassembled ? " (reassembled)" : ""));
+        if (g_verbose) {
+            std::cerr << packet_visualize(payload.data(), payload.size(), false, false) << std::endl;
+        }
+        
+#ifdef WITH_UI
+        if (g_ui_state) {
+            g_ui_state->add_packet(false, payload.size(), snr);
+        }
+#endif
+        
+        if (on_rx_frame) {
+            on_rx_frame(payload, snr, was_reassembled, call);
+        }
+        
+        // Wrapped once, and only if some client wants the frame
+        std::vector<uint8_t> kiss_frame;
+        
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (auto& client : clients_) {
+            if (!client->filter.matches(0, call, payload.data(), payload.size())) continue;
+            if (kiss_frame.empty()) kiss_frame = KISSParser::wrap(payload);
+            client->send(kiss_frame);
+        }
+    }
+    
+    static std::string to_hex(uint8_t v) {
+        std::ostringstream oss;
+        oss << std::hex << std::setfill('0') << std::setw(2) << (int)v;
+        return oss.str();
+    }
+    
+    uint8_t local_caps() const {
+        uint8_t caps = 0;
+        if (config_.aggregation != AggregationMode::OFF) caps |= Ext::CAP_AGGREGATE;
+        if (config_.arq_enabled && config_.fragmentation_enabled) caps |= Ext::CAP_ARQ;
+        if (config_.compression) caps |= Ext::CAP_COMPRESS;
+        if (config_.header_compression) caps |= Ext::CAP_HDRCOMP;
+        if (config_.bulk_threshold > 0) caps |= Ext::CAP_BULK;
+        return caps;
+    }
+    
+    bool header_compression_active() const {
+        return config_.header_compression && peers_.all_capable(Ext::CAP_HDRCOMP);
+    }
+    
+    // Appends a queued frame as an aggregate entry, header compressed if 
+    // hc is set and even an install would still fit
+    bool append_tx_entry(std::vector<uint8_t>& framed, const TxFrame& frame, size_t capacity, bool hc) {
+        if (hc && !frame.flags && !reassembler_.is_fragment(frame.data) &&
+            framed.size() + Ext::ENTRY_HEADER_SIZE + frame.data.size() + HdrComp::INSTALL_SIZE <= capacity) {
+            auto data = frame.data;
+            if (hdr_tx_.compress(data)) {
+                return Ext::append_entry(framed, data, capacity, Ext::ENTRY_HDRCOMP);
+            }
+        }
+        return Ext::append_entry(framed, frame.data, capacity, frame.flags);
+    }
+    
+    bool compression_active() const {
+        return config_.compression && peers_.all_capable(Ext::CAP_COMPRESS);
+    }
+    
+    // ARQ is only used while every station heard can answer polls
+    bool arq_active() const {
+        return (local_caps() & Ext::CAP_ARQ) && peers_.all_capable(Ext::CAP_ARQ);
+    }
+    
+    // How long to wait for a status after a poll: our frame, the receiver's
+    // RX lockout and channel access, and its status frame in the base mode
+    int arq_timeout_ms(int mode) const {
+        Modes::Info ours, theirs;
+        float on_air = (Modes::info(mode, ours) ? ours.duration : 0) +
+                       (Modes::info(modem_config_.oper_mode, theirs) ? theirs.duration : 0);
+        int keying_ms = config_.tx_delay_ms + config_.ptt_delay_ms + config_.ptt_tail_ms;
+        return static_cast<int>(on_air * 1000) + config_.rx_guard_ms + 2 * keying_ms +
+               2 * config_.slot_time_ms + ARQ_TIMEOUT_SLACK_MS;
+    }
+    
+    void send_arq_status(const std::string& to, uint16_t packet_id, bool complete) {
+        Arq::Status status;
+        status.to = ModemConfig::encode_callsign(to.c_str());
+        status.packet_id = packet_id;
+        if (status.to < 0) return;
+        
+        if (complete) {
+            status.flags = Arq::STATUS_COMPLETE;
+        } else {
+            bool last_known = false;
+            if (!reassembler_.missing(packet_id, status.count, last_known, status.missing)) {
+                status.count = 0;  // nothing received yet, everything is missing
+            }
+            if (last_known) status.flags |= Arq::STATUS_LAST_KNOWN;
+        }
+        if (g_verbose) {
+            std::cerr << "ARQ: Status for " << to << " packet " << packet_id 
+                      << (complete ? " complete" : "") << std::endl;
+        }
+        
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        control_queue_.push_back(Arq::encode_status(local_caps(), status));
+    }
+    
+    void send_hc_nack(const std::string& to, uint8_t cid, uint8_t gen) {
+        int64_t call = ModemConfig::encode_callsign(to.c_str());
+        if (call < 0) return;
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        control_queue_.push_back(HdrComp::encode_nack(local_caps(), call, cid, gen));
+    }
+    
+    void handle_arq_status(const Arq::Status& status, const std::string& from) {
+        bool done;
+        auto window = arq_.on_status(status, done);
+        if (done) {
+            ui_log("ARQ: Packet " + std::to_string(status.packet_id) + " confirmed by " + from);
+            TxAck ack;
+            {
+                std::lock_guard<std::mutex> lock(control_mutex_);
+                auto it = arq_acks_.find(status.packet_id);
+                if (it != arq_acks_.end()) {
+                    ack = it->second;
+                    arq_acks_.erase(it);
+                }
+            }
+            send_ack(ack);
+        } else if (!window.retransmit.empty() || !window.fresh.empty()) {
+            ui_log("ARQ: " + from + " reports packet " + std::to_string(status.packet_id) + 
+                   ", resending " + std::to_string(window.retransmit.size()) + ", sending " +
+                   std::to_string(window.fresh.size()) + " new fragment(s)");
+            // Only repairs jump the queue; the rest of the packet waits its
+            // flow's turn like any other traffic
+            if (!window.retransmit.empty()) {
+                tx_queue_.push_batch(std::move(window.retransmit), true);
+            }
+            if (!window.fresh.empty()) {
+                tx_queue_.push_batch(std::move(window.fresh), false, 0, TxAck(), window.flow);
+            }
+        }
+        publish_queue_stats();
+    }
+    
+    // Re-polls unanswered packets, gives up on the hopeless ones
+    void service_arq() {
+        std::vector<uint16_t> failed;
+        auto polls = arq_.check_timeouts(failed);
+        for (uint16_t id : failed) {
+            ui_log("ARQ: Giving up on packet " + std::to_string(id));
+            TxAck ack;
+            {
+                std::lock_guard<std::mutex> lock(control_mutex_);
+                auto it = arq_acks_.find(id);
+                if (it != arq_acks_.end()) {
+                    ack = it->second;
+                    arq_acks_.erase(it);
+                }
+            }
+            drop_ack(ack);
+        }
+        if (!polls.empty()) {
+            if (g_verbose) {
+                std::cerr << "ARQ: Status timeout, polling " << polls.size() << " packet(s) again" << std::endl;
+            }
+            tx_queue_.push_batch(std::move(polls), true);
+        }
+    }
+    
+    // Sends the earliest scheduled frame if it is time to key up for it.
+    // The submitter picked the time, no lockout or CSMA.
+    bool serve_scheduled() {
+        std::vector<uint8_t> frame;
+        TxAck ack;
+        std::chrono::steady_clock::time_point start_at;
+        if (!pop_scheduled(frame, ack, start_at)) return false;
+        transmit(frame_with_length(frame), modem_config_.oper_mode, start_at);
+        send_ack(ack);
+        return true;
+    }
+    
+    // When the TX thread has to pick up the earliest scheduled frame
+    std::chrono::steady_clock::time_point next_scheduled() {
+        std::lock_guard<std::mutex> lock(scheduled_mutex_);
+        if (scheduled_.empty()) return std::chrono::steady_clock::time_point::max();
+        return scheduled_due_locked();
+    }
+    
+    std::chrono::steady_clock::time_point scheduled_due_locked() const {
+        return scheduled_.begin()->first - tx_lead_time() - std::chrono::milliseconds(SCHEDULE_MARGIN_MS);
+    }
+    
+    // The earliest scheduled frame once it is time to key up for it
+    bool pop_scheduled(std::vector<uint8_t>& frame, TxAck& ack, std::chrono::steady_clock::time_point& start_at) {
+        std::lock_guard<std::mutex> lock(scheduled_mutex_);
+        if (scheduled_.empty()) return false;
+        auto it = scheduled_.begin();
+        if (std::chrono::steady_clock::now() < scheduled_due_locked()) {
+            return false;
+        }
+        start_at = it->first;
+        frame = std::move(it->second.first);
+        ack = it->second.second;
+        scheduled_.erase(it);
+        return true;
+    }
+    
+    // Keying ahead of the first OFDM sample: VOX lead tone, or PTT delay
+    // plus TXDelay
+    std::chrono::milliseconds tx_lead_time() const {
+        if (config_.ptt_type == PTTType::VOX) return std::chrono::milliseconds(config_.vox_lead_ms);
+        return std::chrono::milliseconds(config_.ptt_delay_ms + config_.tx_delay_ms);
+    }
+    
+    bool pop_control(std::vector<uint8_t>& frame) {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        if (control_queue_.empty()) return false;
+        frame = std::move(control_queue_.front());
+        control_queue_.pop_front();
+        return true;
+    }
+    
+    bool arq_recently_completed(const std::string& call, uint16_t packet_id) {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        for (const auto& c : arq_completed_) {
+            if (c.second == packet_id && c.first == call) return true;
+        }
+        return false;
     }
     
-    void rx_loop() {
-        rx_running_ = true;
+    void arq_mark_completed(const std::string& call, uint16_t packet_id) {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        arq_completed_.emplace_back(call, packet_id);
+        if (arq_completed_.size() > ARQ_COMPLETED_HISTORY) arq_completed_.pop_front();
+    }
+    
+    bool aggregation_active() const {
+        switch (config_.aggregation) {
+        case AggregationMode::ON:
+            return true;
+        case AggregationMode::AUTO:
+            return peers_.all_capable(Ext::CAP_AGGREGATE);
+        default:
+            return false;
+        }
+    }
+    
+    // Mode for the next transmission. With adaptive modulation this is the 
+    // quickest mode the destination (or the weakest station heard, for 
+    // broadcasts) can decode with margin, never slower than the configured one.
+    int select_tx_mode(const TxFrame& first, bool aggregate) {
+        int base = modem_config_.oper_mode;
+        if (!config_.adaptive_mode) return base;
         
-        std::vector<float> buffer(1024);
-        int level_update_counter = 0;
-        const int LEVEL_UPDATE_INTERVAL = 5;
+        size_t backlog = first.data.size() + (aggregate ? tx_queue_.bytes() : 0);
+        std::string dest = ax25_dest_call(first.data);
+        float ceiling = peers_.ceiling_for(dest);
+        int mode = Modes::select(base, backlog, ceiling);
         
-        auto deliver_to_clients = [this](const std::vector<uint8_t>& payload, float snr, bool was_reassembled) {
-            ui_log("RX: " + std::to_string(payload.size()) + " bytes, SNR=" + 
-                   std::to_string((int)snr) + "dB" + (was_reassembled ? " (reassembled)" : ""));
-            if (g_verbose) {
-                std::cerr << packet_visualize(payload.data(), payload.size(), false, false) << std::endl;
-            }
-            
-#ifdef WITH_UI
-            if (g_ui_state) {
-                g_ui_state->add_packet(false, payload.size(), snr);
-            }
-#endif
-            
-            auto kiss_frame = KISSParser::wrap(payload);
-            
-            std::lock_guard<std::mutex> lock(clients_mutex_);
-            for (auto& client : clients_) {
-                client->send(kiss_frame);
+        if (mode != last_tx_mode_) {
+            ui_log("Adaptive: " + Modes::name(mode) + (dest.empty() ? "" : " for " + dest) +
+                   (std::isinf(ceiling) ? " (no link data)" : " (ceiling " + std::to_string((int)ceiling) + " dB)"));
+            last_tx_mode_ = mode;
+        }
+        return mode;
+    }
+    
+    // Packs the popped frame plus as many queued frames as fit into one 
+    // OFDM frame. Falls back to plain framing if nothing else fits.
+    std::vector<uint8_t> build_tx_frame(const TxFrame& first, size_t& frame_count, int& mode,
+                                        std::vector<TxAck>& acks) {
+        frame_count = 1;
+        if (first.ack.client) acks.push_back(first.ack);
+        bool aggregate = aggregation_active();
+        mode = select_tx_mode(first, aggregate);
+        if (config_.auto_frame_length) {
+            size_t frames = 1 + (aggregate ? tx_queue_.size() : 0);
+            size_t backlog = first.data.size() + (aggregate ? tx_queue_.bytes() : 0);
+            int picked = Modes::pick_length(mode, first.data.size(), frames, backlog, 
+                                            aggregate || first.flags, tx_overhead_seconds());
+            if (picked != mode && g_verbose) {
+                std::cerr << "TX: " << (Modes::is_normal(picked) ? "normal" : "short") << " frame for "
+                          << frames << " frames, " << backlog << " bytes queued" << std::endl;
             }
-        };
+            mode = picked;
+        }
+        if (!aggregate && !first.flags) {
+            arq_.on_sending(first.data, arq_timeout_ms(mode));
+            return frame_with_length(first.data);
+        }
         
-        auto frame_callback = [this, &deliver_to_clients](const uint8_t* data, size_t len) {
-            set_tx_lockout(RX_LOCKOUT_SECONDS);
-            
-            float snr = decoder_->get_last_snr();
-            
-#ifdef WITH_UI
-            if (g_ui_state) {
-                g_ui_state->rx_frame_count++;
-                g_ui_state->receiving = false;
-                g_ui_state->last_rx_snr = snr;
-            }
-#endif
-            
-            auto payload = unframe_length(data, len);
-            
-            if (payload.empty()) {
-                ui_log("RX: Empty payload after unframing");
-#ifdef WITH_UI
-                if (g_ui_state) g_ui_state->rx_error_count++;
-#endif
-                return;
-            }
-            
-            if (config_.fragmentation_enabled && reassembler_.is_fragment(payload)) {
-                if (g_verbose) {
-                    std::cerr << packet_visualize(payload.data(), payload.size(), false, true) << std::endl;
-                }
-                
-                auto reassembled = reassembler_.process(payload);
-                if (!reassembled.empty()) {
-                    ui_log("RX: Reassembled " + std::to_string(reassembled.size()) + " bytes from fragments");
-                    deliver_to_clients(reassembled, snr, true);
-                }
-            } else {
-                deliver_to_clients(payload, snr, false);
-            }
-        };
+        Modes::Info info;
+        size_t capacity = Modes::info(mode, info) ? info.data_bytes : payload_size_;
+        bool hc = aggregate && header_compression_active();
+        auto framed = Ext::header(local_caps(), Ext::TYPE_AGGREGATE);
+        if (!append_tx_entry(framed, first, capacity, hc)) {
+            arq_.on_sending(first.data, arq_timeout_ms(mode));
+            return frame_with_length(first.data);
+        }
+        arq_.on_sending(first.data, arq_timeout_ms(mode));
         
-        bool was_blanking = false;
+        TxFrame next;
+        while (aggregate && framed.size() + Ext::ENTRY_HEADER_SIZE < capacity &&
+               tx_queue_.pop_if_fits(capacity - framed.size() - Ext::ENTRY_HEADER_SIZE, next)) {
+            append_tx_entry(framed, next, capacity, hc);
+            if (next.ack.client) acks.push_back(next.ack);
+            arq_.on_sending(next.data, arq_timeout_ms(mode));
+            frame_count++;
+        }
         
-        while (rx_running_ && g_running) {
-            int n = audio_->read(buffer.data(), buffer.size());
-            if (n > 0) {
-                bool blanking = tx_blanking_active_.load();
-                
-                if (blanking) {
-                    was_blanking = true;
-                } else {
-                    if (was_blanking) {
-                        decoder_->reset();
-                        was_blanking = false;
-                    }
-                    decoder_->process(buffer.data(), n, frame_callback);
-                }
-                
-#ifdef WITH_UI
-                if (g_ui_state && ++level_update_counter >= LEVEL_UPDATE_INTERVAL) {
-                    level_update_counter = 0;
-                    
-                    // Calculate RMS level in dB
-                    float sum_sq = 0.0f;
-                    for (int i = 0; i < n; i++) {
-                        sum_sq += buffer[i] * buffer[i];
-                    }
-                    float rms = std::sqrt(sum_sq / n);
-                    float db = 20.0f * std::log10(rms + 1e-10f);
-                    
-                    g_ui_state->update_level(db);
-                    
-                    // Copy decoder stats
-                    if (g_ui_state->stats_reset_requested.exchange(false)) {
-                        decoder_->stats_sync_count = 0;
-                        decoder_->stats_preamble_errors = 0;
-                        decoder_->stats_symbol_errors = 0;
-                        decoder_->stats_crc_errors = 0;
-                    }
-                    g_ui_state->sync_count = decoder_->stats_sync_count;
-                    g_ui_state->preamble_errors = decoder_->stats_preamble_errors;
-                    g_ui_state->symbol_errors = decoder_->stats_symbol_errors;
-                    g_ui_state->crc_errors = decoder_->stats_crc_errors;
-                }
-#endif
-            }
+        if (frame_count == 1) {
+            // A compressed entry (or header context install) still has to go
+            bool flagged = framed[Ext::HEADER_SIZE] & 0xC0;
+            return flagged ? framed : frame_with_length(first.data);
+        }
+        ui_log("TX: Aggregated " + std::to_string(frame_count) + " frames into " +
+               std::to_string(framed.size()) + "/" + std::to_string(capacity) + " bytes");
+        return framed;
+    }
+    
+    // Airtime every transmission costs besides the OFDM frame itself
+    float tx_overhead_seconds() const {
+        if (config_.ptt_type == PTTType::VOX) {
+            return (config_.vox_lead_ms + config_.vox_tail_ms) / 1000.0f;
+        }
+        return (config_.tx_delay_ms + config_.ptt_delay_ms + config_.ptt_tail_ms) / 1000.0f;
+    }
+    
+    // Hellos are rate limited, a burst of new stations costs one frame
+    bool hello_due() {
+        if (!hello_pending_) return false;
+        if (std::chrono::steady_clock::now() - last_hello_ < std::chrono::milliseconds(Ext::HELLO_INTERVAL_MS)) {
+            return false;
         }
+        hello_pending_ = false;
+        return true;
+    }
+    
+    void send_hello() {
+        last_hello_ = std::chrono::steady_clock::now();
+        ui_log("TX: Hello (caps 0x" + to_hex(local_caps()) + ")");
+        transmit(Ext::header(local_caps(), Ext::TYPE_HELLO), modem_config_.oper_mode);
     }
     
     void set_ptt(bool on) {
@@ -849,7 +2173,20 @@ private:
                 std::cerr << "TX lockout set for " << seconds << "s" << std::endl;
             }
         }
-
+        lockout_cv_.notify_all();
+    }
+    
+    // RX thread, once per block: while a lockout from a received frame is
+    // running, any preamble or frame the decoder sees pushes the release
+    // out to rx_guard_ms after it, so the lockout ends once the decoder has
+    // been searching with nothing on the correlator for the guard time
+    void extend_tx_lockout(bool carrier) {
+        if (!carrier) return;
+        std::lock_guard<std::mutex> lock(lockout_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (now >= tx_lockout_until_) return;
+        tx_lockout_until_ = std::max(tx_lockout_until_, now + std::chrono::milliseconds(config_.rx_guard_ms));
+        lockout_cv_.notify_all();
     }
     
     bool is_tx_allowed() {
@@ -857,16 +2194,18 @@ private:
         return std::chrono::steady_clock::now() >= tx_lockout_until_;
     }
     
+    // Sleeps until the release time; the RX thread notifies when it moves
     void wait_for_tx_allowed(int timeout_ms = 30000) {
-        auto start = std::chrono::steady_clock::now();
-        while (!is_tx_allowed() && g_running) {
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::now() - start).count();
-            if (elapsed > timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::unique_lock<std::mutex> lock(lockout_mutex_);
+        while (g_running && tx_running_) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= tx_lockout_until_) return;
+            if (now >= deadline) {
                 std::cerr << "TX lockout timeout, transmitting anyway" << std::endl;
-                break;
+                return;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            lockout_cv_.wait_until(lock, std::min(tx_lockout_until_, deadline));
         }
     }
     
@@ -888,22 +2227,96 @@ private:
     int server_fd_ = -1;
     std::list<std::unique_ptr<ClientConnection>> clients_;
     std::mutex clients_mutex_;
+    int unix_fd_ = -1;
+    std::unique_ptr<ShmRing::Transport> shm_;
+    std::thread shm_thread_;
+    static constexpr int CLIENT_POLL_MS = 10;
+    uint64_t next_client_id_ = 1;
     
-    PacketQueue<std::vector<uint8_t>> tx_queue_;
+    TxQueue tx_queue_;
     std::atomic<bool> tx_running_{false};
     std::atomic<bool> rx_running_{false};
+    std::thread tx_thread_;
+    std::thread rx_thread_;
+    std::mutex rt_mutex_;
+    std::condition_variable rt_cv_;
+    int rt_ready_ = 0;                   // DSP threads with their stacks prefaulted
     
     Fragmenter fragmenter_;
     Reassembler reassembler_;
     
+    // Stations heard, and their extension capabilities
+    PeerTable peers_;
+    std::atomic<bool> hello_pending_{false};
+    std::chrono::steady_clock::time_point last_hello_;
+    int last_tx_mode_ = -1;
+    
+    // Selective-repeat ARQ. Status frames go out ahead of queued data.
+    ArqSender arq_;
+    std::mutex control_mutex_;
+    std::deque<std::vector<uint8_t>> control_queue_;
+    std::deque<std::pair<std::string, uint16_t>> arq_completed_;
+    std::map<uint16_t, TxAck> arq_acks_;   // ACKMODE tags of ARQ packets in flight
+    static constexpr size_t ARQ_COMPLETED_HISTORY = 32;
+    static constexpr int ARQ_TIMEOUT_SLACK_MS = 1000;
+    static constexpr int ARQ_STALL_MS = 5 * 60 * 1000;
+    
+    DupCache rx_dups_;
+    DupCache tx_dups_;
+    
+    // Carrier sense for CSMA
+    CarrierSense carrier_;
+    NoiseFloor noise_;
+    std::atomic<uint64_t> csma_checks_{0};
+    std::atomic<uint64_t> csma_stale_{0};   // decisions made on a level older than the window
+    std::mutex channel_mutex_;              // RX block events for CSMA
+    std::condition_variable channel_cv_;
+    uint64_t channel_seq_ = 0;
+    std::chrono::steady_clock::time_point csma_clear_at_;   // TX thread only
+    uint64_t csma_keyed_ = 0;
+    double csma_key_total_ms_ = 0;
+    double csma_key_max_ms_ = 0;
+    
+    // Header compression contexts
+    HeaderCompressor hdr_tx_;
+    HeaderDecompressor hdr_rx_;
+    
+    // Fountain-coded bulk objects
+    std::mutex bulk_mutex_;
+    struct BulkObject {
+        std::vector<uint8_t> data;                 // until the encoder is built
+        std::unique_ptr<FountainEncoder> encoder;
+        TxAck ack;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+    static constexpr size_t BULK_MAX_OBJECTS = 16;
+    std::deque<BulkObject> bulk_tx_;
+    size_t bulk_bytes_ = 0;                        // data of the queued objects
+    BulkObject bulk_current_;                      // being sent, TX thread only
+    FountainReceiver bulk_rx_;
+    uint16_t next_object_id_ = 0;
+    
     // TX lockout - prevents TX while receiving
     std::mutex lockout_mutex_;
+    std::condition_variable lockout_cv_;
     std::chrono::steady_clock::time_point tx_lockout_until_;
-    static constexpr float RX_LOCKOUT_SECONDS = 0.5f;
     
     // TX blanking
     std::atomic<bool> tx_blanking_active_{false};
     
+    // Frames sent at a set time (submit_at), earliest first
+    std::mutex scheduled_mutex_;
+    std::multimap<std::chrono::steady_clock::time_point, std::pair<std::vector<uint8_t>, TxAck>> scheduled_;
+    static constexpr int SCHEDULE_MARGIN_MS = 100;   // encoding ahead of keying up
+    static constexpr size_t SCHEDULE_MAX = 32;
+    
+    // Capture time of the last decoded frame's preamble, and whether
+    // capture samples were lost inside it; RX thread
+    std::chrono::steady_clock::time_point rx_frame_time_;
+    bool rx_frame_overrun_ = false;
+    std::atomic<uint64_t> rx_overrun_frames_{0};
+    std::atomic<uint64_t> tx_underrun_frames_{0};
+    
 public:
     // Update config at runtime (called from UI)
     void update_config(const TNCConfig& new_config) {
@@ -975,24 +2388,88 @@ public:
         return false;
     }
     
-    void queue_data(const std::vector<uint8_t>& data) {
-        size_t max_payload = payload_size_ - 2;
-        
-        if (config_.fragmentation_enabled && fragmenter_.needs_fragmentation(data.size(), max_payload)) {
-            auto fragments = fragmenter_.fragment(data, max_payload);
-            ui_log("TX: Fragmenting " + std::to_string(data.size()) + " bytes into " + 
-                   std::to_string(fragments.size()) + " fragments");
-            for (auto& frag : fragments) {
-                tx_queue_.push(std::move(frag));
-            }
-        } else {
-            tx_queue_.push(data);
+    bool queue_data(const std::vector<uint8_t>& data) {
+        return enqueue(data);
+    }
+    
+    // In-process frontends. Set the hooks before start(); they run on the
+    // TX and RX threads.
+    std::function<void(const TxAck&)> on_tx_done;
+    std::function<void(const TxAck&)> on_tx_dropped;   // TTL, queue limits, ARQ gave up
+    std::function<void(const std::vector<uint8_t>&, float, bool, const std::string&)> on_rx_frame;   // payload, SNR, reassembled, call
+    
+    // on_tx_done(id) fires once the packet has left the radio, on_tx_dropped(id)
+    // if it never will. False (and neither fires) if it was dropped at once.
+    bool submit(const std::vector<uint8_t>& data, uint16_t id) {
+        TxAck ack;
+        ack.client = TxAck::LOCAL;
+        ack.id = id;
+        return enqueue(data, ack);
+    }
+    
+    // Sends one OFDM frame so that its first sample leaves the sound card
+    // at start_at, keying up ahead of it. Skips the TX queue, lockout and
+    // CSMA, and is picked up even while the TX thread waits for the
+    // channel (not while it is on air). False if data doesn't fit one frame
+    // or SCHEDULE_MAX frames are waiting already.
+    bool submit_at(const std::vector<uint8_t>& data, const TxAck& ack,
+                   std::chrono::steady_clock::time_point start_at) {
+        if (!fits_one_frame(data.size())) return false;
+        {
+            std::lock_guard<std::mutex> lock(scheduled_mutex_);
+            if (scheduled_.size() >= SCHEDULE_MAX) return false;
+            scheduled_.emplace(start_at, std::make_pair(data, ack));
         }
-#ifdef WITH_UI
-        if (g_ui_state) {
-            g_ui_state->tx_queue_size = tx_queue_.size();
+        // Out of a CSMA wait, to look at the new due time
+        {
+            std::lock_guard<std::mutex> lock(channel_mutex_);
+            channel_seq_++;
         }
-#endif
+        channel_cv_.notify_all();
+        return true;
+    }
+    
+    bool fits_one_frame(size_t len) const { return len <= (size_t)payload_size_ - 2; }
+    
+    // When the preamble of the frame being delivered reached the sound
+    // card; valid inside on_rx_frame
+    std::chrono::steady_clock::time_point last_rx_time() const { return rx_frame_time_; }
+    
+    // Whether the OFDM frame that completed it spans a capture overrun;
+    // valid inside on_rx_frame
+    bool last_rx_overrun() const { return rx_frame_overrun_; }
+    
+    // Audio overruns and underruns, and the frames they hit
+    struct AudioStats {
+        uint64_t capture_overruns = 0;
+        uint64_t capture_lost = 0;
+        uint64_t playback_underruns = 0;
+        uint64_t playback_padded = 0;
+        uint64_t rx_overrun_frames = 0;
+        uint64_t tx_underrun_frames = 0;
+    };
+    
+    AudioStats audio_stats() const {
+        AudioStats s;
+        if (audio_) {
+            s.capture_overruns = audio_->capture_overruns();
+            s.capture_lost = audio_->capture_lost();
+            s.playback_underruns = audio_->playback_underruns();
+            s.playback_padded = audio_->playback_padded();
+        }
+        s.rx_overrun_frames = rx_overrun_frames_;
+        s.tx_underrun_frames = tx_underrun_frames_;
+        return s;
+    }
+    
+    // Use process_samples() instead of an audio device, call before start()
+    void use_sample_stream() {
+        audio_ = std::make_unique<MiniAudio>("", "", config_.sample_rate, config_.audio_buffer_ms);
+        audio_->open_stream();
+    }
+    
+    int process_samples(const float* in, float* out, int frames) {
+        return audio_ ? audio_->process_stream(in, out, frames) : -1;
     }
 };
 
@@ -1005,12 +2482,19 @@ void print_help(const char* prog) {
               << "  --input-device DEV      Audio input  device\n"
               << "  --output-device DEV     Audio output device\n"
               << "  --list-audio            List available audio devices and exit\n"
+              << "  --audio-buffer MS       Capture/playback ring size, rounded up to a power of two\n"
+              << "                          (default: 1000)\n"
               << "  -c, --callsign CALL     Callsign (default: N0CALL)\n"
               << "  -m, --modulation MOD    BPSK/QPSK/8PSK/QAM16/QAM64/QAM256 (default: QPSK)\n"
               << "  -r, --rate RATE         Code rate: 1/2, 2/3, 3/4, 5/6, 1/4 (default: 1/2)\n"
               << "  -f, --freq FREQ         Center frequency in Hz (default: 1500)\n"
               << "  --short                 Use short frames\n"
               << "  --normal                Use normal frames (default)\n"
+              << "  --auto-length           Pick short or normal frames per transmission for the\n"
+              << "                          least airtime (fragments keep the configured size)\n"
+              << "\nLocal clients:\n"
+              << "  --unix PATH             Also serve KISS on a Unix-domain socket\n"
+              << "  --shm NAME              Also serve KISS over a shared-memory ring pair (shm_ring.hh)\n"
               << "\nPTT options:\n"
               << "  --ptt TYPE              PTT type: none, rigctl, vox, com"
 #ifdef WITH_CM108
@@ -1033,12 +2517,61 @@ void print_help(const char* prog) {
               << "  --csma-threshold DB     Carrier sense threshold (default: -30)\n"
               << "  --csma-slot MS          Slot time in ms (default: 500)\n"
               << "  --csma-persist N        P-persistence 0-255 (default: 128 = 50%)\n"
+              << "  --csma-auto             Threshold follows the band noise floor + margin\n"
+              << "  --csma-margin DB        Margin above the noise floor (default: 10)\n"
+              << "  --noise-window S        Noise floor memory in seconds (default: 300)\n"
+              << "  --csma-detect MODE      Busy when: energy (level above threshold), dcd (decoder\n"
+              << "                          sees a preamble or frame), either (default: energy)\n"
+              << "  --rx-guard MS           Hold TX after a received frame until the decoder has\n"
+              << "                          heard no preamble for MS (default: 100)\n"
+              << "\nTX queue:\n"
+              << "  --tx-queue-max N        Max queued frames, 0 = unlimited (default: 512)\n"
+              << "  --tx-queue-bytes N      Max queued bytes, 0 = unlimited (default: 4194304)\n"
+              << "  --tx-ttl MS             Drop packets queued longer than MS, 0 = never (default: 60000);\n"
+              << "                          fragments go together, and never once the first is sent\n"
+              << "  --tx-drop POLICY        When full: tail (reject new) or head (drop oldest) (default: tail)\n"
+              << "  --tx-fair               Share airtime between clients (deficit round robin)\n"
+              << "  --tx-weight PORT=W      Airtime weight of a KISS port with --tx-fair (default: 1)\n"
               << "\nFragmentation:\n"
               << "  --frag                  Enable packet fragmentation/reassembly\n"
               << "  --no-frag               Disable fragmentation (default)\n"
+              << "\nAdaptive modulation:\n"
+              << "  --adaptive              Pick modulation/code rate per peer from measured SNR\n"
+              << "                          (the configured mode is the robust fallback)\n"
+              << "  --adaptive-margin DB    SNR margin above a mode's requirement (default: 3)\n"
+              << "  --adaptive-hyst DB      Extra SNR before stepping up (default: 2)\n"
+              << "\nAggregation:\n"
+              << "  --aggregate MODE        Pack several frames per OFDM frame: off, auto, on (default: off)\n"
+              << "                          auto only aggregates while all stations heard support it\n"
+              << "\nARQ:\n"
+              << "  --arq                   Selective-repeat ARQ for fragmented packets (implies --frag)\n"
+              << "                          only used while all stations heard support it\n"
+              << "  --arq-window N          Fragments per status poll, 0 = from frame airtime (default: 0)\n"
+              << "  --arq-retries N         Unanswered polls before giving up a packet (default: 5)\n"
+              << "\nCompression:\n"
+              << "  --compress              Compress payloads (preset dictionary LZ77) when it saves\n"
+              << "                          airtime, while all stations heard support it\n"
+              << "  --hdr-compress          Replace repeated AX.25 address fields and Reticulum\n"
+              << "                          destination hashes with context ids (needs --aggregate)\n"
+              << "\nBulk transfer:\n"
+              << "  --bulk BYTES            Send payloads of at least BYTES as fountain-coded objects,\n"
+              << "                          decodable from any ~K(1+e) frames, 0 = off (default: 0)\n"
+              << "                          only used while all stations heard support it\n"
+              << "  --bulk-overhead PCT     Repair frames in percent of source frames, 0-1000 (default: 40)\n"
+              << "\nDuplicate suppression:\n"
+              << "  --dedup-rx              Deliver identical payloads heard within the window once\n"
+              << "  --dedup-tx              Drop submitted payloads identical to one sent within the window\n"
+              << "  --dedup-window MS       Window for both (default: 30000)\n"
               << "\nTX Blanking:\n"
               << "  --tx-blank              Suppress decoder during TX\n"
               << "  --no-tx-blank           Disable TX blanking (default)\n"
+              << "\nReal-time (best effort, reported at startup):\n"
+              << "  --rt-priority N         SCHED_FIFO priority 1-99 for the RX and TX threads, 0 = off\n"
+              << "                          (needs CAP_SYS_NICE or an rtprio limit)\n"
+              << "  --rt-rr                 SCHED_RR instead of SCHED_FIFO\n"
+              << "  --rx-cpu N              Pin the RX thread to CPU N\n"
+              << "  --tx-cpu N              Pin the TX thread to CPU N\n"
+              << "  --mlock                 Lock memory and pre-fault the DSP buffers (needs a memlock limit)\n"
               << "\n"
 #ifdef WITH_UI
               << "  -h, --headless          Run without TUI\n"
@@ -1114,7 +2647,302 @@ void run_tnc(TNCConfig& config, TNCUIState& ui_state, std::atomic<bool>& /*runni
 }
 #endif // MODEM73_GUI_MODE
 
-#ifndef MODEM73_GUI_MODE
+// libmodem73 C API (libmodem73.h), built with -DMODEM73_LIB_MODE
+#ifdef MODEM73_LIB_MODE
+#include "libmodem73.h"
+#include <condition_variable>
+
+namespace {
+    thread_local std::string g_lib_error;
+    m73_log_fn g_lib_log = nullptr;
+    void* g_lib_log_user = nullptr;
+    
+    constexpr size_t LIB_RX_QUEUE_MAX = 256;   // undelivered frames, oldest dropped
+    
+    struct LibRxFrame {
+        std::vector<uint8_t> data;
+        m73_rx_info info;
+    };
+    
+    // steady_clock and Unix time, through the current offset between them
+    uint64_t to_unix_ms(std::chrono::steady_clock::time_point t) {
+        auto unix_now = std::chrono::system_clock::now().time_since_epoch();
+        auto unix_t = unix_now - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::steady_clock::now() - t);
+        return std::chrono::duration_cast<std::chrono::milliseconds>(unix_t).count();
+    }
+    
+    std::chrono::steady_clock::time_point from_unix_ms(uint64_t ms) {
+        auto unix_now = std::chrono::system_clock::now().time_since_epoch();
+        auto ahead = std::chrono::milliseconds(ms) - unix_now;
+        return std::chrono::steady_clock::now() +
+               std::chrono::duration_cast<std::chrono::steady_clock::duration>(ahead);
+    }
+}
+
+struct m73_modem {
+    std::unique_ptr<KISSTNC> tnc;
+    bool external_audio = false;
+    
+    std::mutex mutex;
+    std::condition_variable rx_cv;
+    std::deque<LibRxFrame> rx_queue;
+    
+    struct Pending {
+        m73_tx_done_fn fn;
+        void* user;
+    };
+    std::map<uint16_t, Pending> pending;   // by TxAck id
+    uint16_t next_id = 0;
+    
+    // Files a callback under the next id not still pending, so a wrapped
+    // counter never replaces one; false if all 65536 are in use
+    bool add_pending(m73_tx_done_fn fn, void* user, uint16_t& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.size() > UINT16_MAX) return false;
+        while (pending.count(next_id)) next_id++;
+        id = next_id++;
+        pending[id] = {fn, user};
+        return true;
+    }
+    
+    // Runs and forgets the callback of a submitted frame
+    void complete(uint16_t id, int status) {
+        Pending done{nullptr, nullptr};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = pending.find(id);
+            if (it == pending.end()) return;
+            done = it->second;
+            pending.erase(it);
+        }
+        done.fn(done.user, status);
+    }
+};
+
+void ui_log(const std::string& msg) {
+    if (g_lib_log) {
+        g_lib_log(g_lib_log_user, msg.c_str());
+    } else if (g_verbose) {
+        std::cerr << msg << std::endl;
+    }
+}
+
+extern "C" {
+
+void m73_config_init(m73_config* cfg) {
+    if (!cfg) return;
+    std::memset(cfg, 0, sizeof(*cfg));
+    cfg->callsign = "N0CALL";
+    cfg->modulation = "QPSK";
+    cfg->code_rate = "1/2";
+    cfg->center_freq = 1500;
+    cfg->sample_rate = 48000;
+    cfg->input_device = "default";
+    cfg->output_device = "default";
+    cfg->ptt = "none";
+    cfg->rigctl_host = "localhost";
+    cfg->rigctl_port = 4532;
+    cfg->com_port = "COM3";
+    cfg->csma = 1;
+}
+
+const char* m73_last_error(void) {
+    return g_lib_error.c_str();
+}
+
+void m73_set_log(m73_log_fn fn, void* user) {
+    g_lib_log = fn;
+    g_lib_log_user = user;
+}
+
+m73_modem* m73_open(const m73_config* cfg) {
+    if (!cfg) {
+        g_lib_error = "no configuration";
+        return nullptr;
+    }
+    
+    TNCConfig config;
+    if (cfg->callsign) config.callsign = cfg->callsign;
+    if (cfg->modulation) config.modulation = cfg->modulation;
+    if (cfg->code_rate) config.code_rate = cfg->code_rate;
+    config.short_frame = cfg->short_frame != 0;
+    config.center_freq = cfg->center_freq;
+    config.sample_rate = cfg->sample_rate;
+    if (cfg->input_device) config.audio_input_device = cfg->input_device;
+    if (cfg->output_device) config.audio_output_device = cfg->output_device;
+    if (cfg->rigctl_host) config.rigctl_host = cfg->rigctl_host;
+    config.rigctl_port = cfg->rigctl_port;
+    if (cfg->com_port) config.com_port = cfg->com_port;
+    config.csma_enabled = cfg->csma != 0;
+    config.fragmentation_enabled = cfg->fragmentation != 0;
+    g_verbose = cfg->verbose != 0;
+    
+    std::string ptt = cfg->ptt ? cfg->ptt : "none";
+    if (ptt == "none") config.ptt_type = PTTType::NONE;
+    else if (ptt == "rigctl") config.ptt_type = PTTType::RIGCTL;
+    else if (ptt == "vox") config.ptt_type = PTTType::VOX;
+    else if (ptt == "com") config.ptt_type = PTTType::COM;
+#ifdef WITH_CM108
+    else if (ptt == "cm108") config.ptt_type = PTTType::CM108;
+#endif
+    else {
+        g_lib_error = "unknown PTT type: " + ptt;
+        return nullptr;
+    }
+    
+    auto m = std::make_unique<m73_modem>();
+    m73_modem* self = m.get();
+    try {
+        m->tnc = std::make_unique<KISSTNC>(config);
+        
+        m->tnc->on_tx_done = [self](const TxAck& ack) {
+            self->complete(ack.id, M73_OK);
+        };
+        
+        m->tnc->on_tx_dropped = [self](const TxAck& ack) {
+            self->complete(ack.id, M73_ERR_DROPPED);
+        };
+        
+        m->tnc->on_rx_frame = [self](const std::vector<uint8_t>& payload, float snr, bool reassembled,
+                                     const std::string& call) {
+            LibRxFrame frame;
+            frame.data = payload;
+            std::memset(&frame.info, 0, sizeof(frame.info));
+            frame.info.length = payload.size();
+            frame.info.snr_db = snr;
+            frame.info.reassembled = reassembled;
+            std::strncpy(frame.info.callsign, call.c_str(), M73_CALLSIGN_MAX - 1);
+            frame.info.time_ms = to_unix_ms(self->tnc->last_rx_time());
+            frame.info.overrun = self->tnc->last_rx_overrun();
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                if (self->rx_queue.size() >= LIB_RX_QUEUE_MAX) {
+                    self->rx_queue.pop_front();
+                }
+                self->rx_queue.push_back(std::move(frame));
+            }
+            self->rx_cv.notify_one();
+        };
+        
+        if (cfg->external_audio) {
+            m->tnc->use_sample_stream();
+            m->external_audio = true;
+        }
+        m->tnc->start();
+    } catch (const std::exception& e) {
+        g_lib_error = e.what();
+        if (m->tnc) m->tnc->stop();
+        return nullptr;
+    }
+    return m.release();
+}
+
+void m73_close(m73_modem* m) {
+    if (!m) return;
+    m->tnc->stop();
+    // Frames still waiting will never go out
+    for (const auto& p : m->pending) p.second.fn(p.second.user, M73_ERR_DROPPED);
+    delete m;
+}
+
+int m73_submit(m73_modem* m, const uint8_t* data, size_t len, m73_tx_done_fn done, void* user) {
+    if (!m || (!data && len)) return M73_ERR_ARG;
+    std::vector<uint8_t> frame(data, data + len);
+    
+    if (!done) {
+        if (!m->tnc->queue_data(frame)) {
+            g_lib_error = "frame dropped, TX queue full or duplicate";
+            return M73_ERR_FULL;
+        }
+        return M73_OK;
+    }
+    
+    uint16_t id;
+    if (!m->add_pending(done, user, id)) {
+        g_lib_error = "too many frames pending";
+        return M73_ERR_FULL;
+    }
+    if (!m->tnc->submit(frame, id)) {
+        std::lock_guard<std::mutex> lock(m->mutex);
+        m->pending.erase(id);
+        g_lib_error = "frame dropped, TX queue full";
+        return M73_ERR_FULL;
+    }
+    return M73_OK;
+}
+
+int m73_submit_at(m73_modem* m, const uint8_t* data, size_t len, uint64_t at_ms,
+                  m73_tx_done_fn done, void* user) {
+    if (!m || (!data && len)) return M73_ERR_ARG;
+    std::vector<uint8_t> frame(data, data + len);
+    
+    if (!m->tnc->fits_one_frame(len)) {
+        g_lib_error = "frame does not fit one OFDM frame";
+        return M73_ERR_ARG;
+    }
+    
+    TxAck ack;
+    if (done) {
+        if (!m->add_pending(done, user, ack.id)) {
+            g_lib_error = "too many frames pending";
+            return M73_ERR_FULL;
+        }
+        ack.client = TxAck::LOCAL;
+    }
+    if (!m->tnc->submit_at(frame, ack, from_unix_ms(at_ms))) {
+        if (done) {
+            std::lock_guard<std::mutex> lock(m->mutex);
+            m->pending.erase(ack.id);
+        }
+        g_lib_error = "too many frames scheduled";
+        return M73_ERR_FULL;
+    }
+    return M73_OK;
+}
+
+int m73_get_stats(m73_modem* m, m73_stats* stats) {
+    if (!m || !stats) return M73_ERR_ARG;
+    auto s = m->tnc->audio_stats();
+    stats->capture_overruns = s.capture_overruns;
+    stats->capture_lost = s.capture_lost;
+    stats->playback_underruns = s.playback_underruns;
+    stats->playback_padded = s.playback_padded;
+    stats->rx_overrun_frames = s.rx_overrun_frames;
+    stats->tx_underrun_frames = s.tx_underrun_frames;
+    return M73_OK;
+}
+
+int m73_receive(m73_modem* m, uint8_t* buf, size_t cap, m73_rx_info* info, int timeout_ms) {
+    if (!m || (!buf && cap)) return M73_ERR_ARG;
+    
+    std::unique_lock<std::mutex> lock(m->mutex);
+    auto ready = [m] { return !m->rx_queue.empty(); };
+    if (timeout_ms < 0) {
+        m->rx_cv.wait(lock, ready);
+    } else if (!m->rx_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+        return 0;
+    }
+    
+    LibRxFrame& frame = m->rx_queue.front();
+    if (info) *info = frame.info;
+    if (frame.data.size() > cap) return M73_ERR_BUFFER;
+    
+    std::memcpy(buf, frame.data.data(), frame.data.size());
+    int n = static_cast<int>(frame.data.size());
+    m->rx_queue.pop_front();
+    return n;
+}
+
+int m73_process_audio(m73_modem* m, const float* in, float* out, int frames) {
+    if (!m || !m->external_audio) return M73_ERR_ARG;
+    return m->tnc->process_samples(in, out, frames);
+}
+
+} // extern "C"
+#endif // MODEM73_LIB_MODE
+
+#if !defined(MODEM73_GUI_MODE) && !defined(MODEM73_LIB_MODE)
 int main(int argc, char** argv) {
     TNCConfig config;
     
@@ -1153,6 +2981,8 @@ int main(int argc, char** argv) {
             config.audio_input_device = argv[++i];
         } else if (arg == "--output-device" && i + 1 < argc) {
             config.audio_output_device = argv[++i];
+        } else if (arg == "--audio-buffer" && i + 1 < argc) {
+            config.audio_buffer_ms = std::atoi(argv[++i]);
         } else if ((arg == "-c" || arg == "--callsign") && i + 1 < argc) {
             config.callsign = argv[++i];
         } else if ((arg == "-m" || arg == "--modulation") && i + 1 < argc) {
@@ -1165,6 +2995,8 @@ int main(int argc, char** argv) {
             config.short_frame = true;
         } else if (arg == "--normal") {
             config.short_frame = false;
+        } else if (arg == "--auto-length") {
+            config.auto_frame_length = true;
         } else if (arg == "--rigctl" && i + 1 < argc) {
             config.ptt_type = PTTType::RIGCTL;
             std::string hostport = argv[++i];
@@ -1227,10 +3059,117 @@ int main(int argc, char** argv) {
             config.slot_time_ms = std::atoi(argv[++i]);
         } else if (arg == "--csma-persist" && i + 1 < argc) {
             config.p_persistence = std::atoi(argv[++i]);
+        } else if (arg == "--rx-guard" && i + 1 < argc) {
+            config.rx_guard_ms = std::atoi(argv[++i]);
+        } else if (arg == "--rt-priority" && i + 1 < argc) {
+            config.rt_priority = std::atoi(argv[++i]);
+        } else if (arg == "--rt-rr") {
+            config.rt_round_robin = true;
+        } else if (arg == "--rx-cpu" && i + 1 < argc) {
+            config.rx_cpu = std::atoi(argv[++i]);
+        } else if (arg == "--tx-cpu" && i + 1 < argc) {
+            config.tx_cpu = std::atoi(argv[++i]);
+        } else if (arg == "--mlock") {
+            config.rt_mlock = true;
+        } else if (arg == "--tx-queue-max" && i + 1 < argc) {
+            config.tx_queue_max_frames = std::atoi(argv[++i]);
+            if (config.tx_queue_max_frames < 0) {
+                std::cerr << "Invalid --tx-queue-max: " << argv[i] << " (0 = unlimited)\n";
+                return 1;
+            }
+        } else if (arg == "--tx-queue-bytes" && i + 1 < argc) {
+            config.tx_queue_max_bytes = std::atoi(argv[++i]);
+            if (config.tx_queue_max_bytes < 0) {
+                std::cerr << "Invalid --tx-queue-bytes: " << argv[i] << " (0 = unlimited)\n";
+                return 1;
+            }
+        } else if (arg == "--tx-ttl" && i + 1 < argc) {
+            config.tx_frame_ttl_ms = std::atoi(argv[++i]);
+        } else if (arg == "--csma-auto") {
+            config.csma_auto_threshold = true;
+        } else if (arg == "--csma-margin" && i + 1 < argc) {
+            config.csma_margin_db = std::atof(argv[++i]);
+        } else if (arg == "--noise-window" && i + 1 < argc) {
+            config.noise_window_s = std::atoi(argv[++i]);
+        } else if (arg == "--csma-detect" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "energy") config.csma_detect = CsmaDetect::ENERGY;
+            else if (mode == "dcd") config.csma_detect = CsmaDetect::DCD;
+            else if (mode == "either") config.csma_detect = CsmaDetect::EITHER;
+            else {
+                std::cerr << "Unknown CSMA detect mode: " << mode << " (use energy, dcd or either)\n";
+                return 1;
+            }
+        } else if (arg == "--tx-drop" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "tail") config.tx_drop_policy = TxDropPolicy::TAIL;
+            else if (policy == "head") config.tx_drop_policy = TxDropPolicy::HEAD;
+            else {
+                std::cerr << "Unknown drop policy: " << policy << " (use head or tail)\n";
+                return 1;
+            }
+        } else if (arg == "--tx-fair") {
+            config.tx_fairness = true;
+        } else if (arg == "--tx-weight" && i + 1 < argc) {
+            std::string spec = argv[++i];
+            size_t eq = spec.find('=');
+            int port = std::atoi(spec.substr(0, eq).c_str());
+            float weight = eq == std::string::npos ? 0 : std::atof(spec.c_str() + eq + 1);
+            if (eq == std::string::npos || port < 0 || port > 15 || weight <= 0) {
+                std::cerr << "Invalid TX weight: " << spec << " (use PORT=WEIGHT)\n";
+                return 1;
+            }
+            config.tx_weights[port] = weight;
         } else if (arg == "--frag") {
             config.fragmentation_enabled = true;
         } else if (arg == "--no-frag") {
             config.fragmentation_enabled = false;
+        } else if (arg == "--adaptive") {
+            config.adaptive_mode = true;
+        } else if (arg == "--adaptive-margin" && i + 1 < argc) {
+            config.adaptive_margin_db = std::atof(argv[++i]);
+        } else if (arg == "--adaptive-hyst" && i + 1 < argc) {
+            config.adaptive_hysteresis_db = std::atof(argv[++i]);
+        } else if (arg == "--aggregate" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "off") config.aggregation = AggregationMode::OFF;
+            else if (mode == "auto") config.aggregation = AggregationMode::AUTO;
+            else if (mode == "on") config.aggregation = AggregationMode::ON;
+            else {
+                std::cerr << "Unknown aggregation mode: " << mode << " (use off, auto or on)\n";
+                return 1;
+            }
+        } else if (arg == "--arq") {
+            config.arq_enabled = true;
+            config.fragmentation_enabled = true;
+        } else if (arg == "--arq-window" && i + 1 < argc) {
+            config.arq_window = std::atoi(argv[++i]);
+        } else if (arg == "--arq-retries" && i + 1 < argc) {
+            config.arq_max_retries = std::atoi(argv[++i]);
+        } else if (arg == "--compress") {
+            config.compression = true;
+        } else if (arg == "--hdr-compress") {
+            config.header_compression = true;
+        } else if (arg == "--bulk" && i + 1 < argc) {
+            config.bulk_threshold = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--unix" && i + 1 < argc) {
+            config.unix_socket = argv[++i];
+        } else if (arg == "--shm" && i + 1 < argc) {
+            config.shm_name = argv[++i];
+        } else if (arg == "--bulk-overhead" && i + 1 < argc) {
+            double pct = std::atof(argv[++i]);
+            if (!(pct >= 0 && pct <= Fountain::MAX_OVERHEAD * 100)) {
+                std::cerr << "Invalid --bulk-overhead: " << argv[i] << " (0 to "
+                          << (int)(Fountain::MAX_OVERHEAD * 100) << ")\n";
+                return 1;
+            }
+            config.bulk_overhead = static_cast<float>(pct / 100.0);
+        } else if (arg == "--dedup-rx") {
+            config.dedup_rx = true;
+        } else if (arg == "--dedup-tx") {
+            config.dedup_tx = true;
+        } else if (arg == "--dedup-window" && i + 1 < argc) {
+            config.dedup_window_ms = std::atoi(argv[++i]);
         } else if (arg == "--tx-blank") {
             config.tx_blanking_enabled = true;
         } else if (arg == "--no-tx-blank") {
@@ -1523,4 +3462,4 @@ int main(int argc, char** argv) {
     
     return 0;
 }
-#endif // MODEM73_GUI_MODE
\ No newline at end of file
+#endif // !MODEM73_GUI_MODE && !MODEM73_LIB_MODE
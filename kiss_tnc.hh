@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <array>
 #include <vector>
-#include <queue>
 #include <map>
 #include <mutex>
 #include <atomic>
@@ -12,6 +14,10 @@
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <random>
 
 // KISS protocol
 namespace KISS {
@@ -28,6 +34,7 @@ namespace KISS {
     constexpr uint8_t CMD_TXTAIL   = 0x04;
     constexpr uint8_t CMD_FULLDUPLEX = 0x05;
     constexpr uint8_t CMD_SETHW    = 0x06;
+    constexpr uint8_t CMD_ACKMODE  = 0x0C;   // [ack id:2] [data], echoed once on air
     constexpr uint8_t CMD_RETURN   = 0xFF;
 }
 
@@ -42,15 +49,38 @@ enum class PTTType {
 #endif
 };
 
+// What to discard when the TX queue is full
+enum class TxDropPolicy {
+    TAIL = 0,   // reject the new frame
+    HEAD = 1,   // discard the oldest queued frames
+};
+
+// What CSMA treats as a busy channel
+enum class CsmaDetect {
+    ENERGY = 0,   // audio level above carrier_threshold_db
+    DCD = 1,      // the decoder sees a preamble or is collecting a frame
+    EITHER = 2,   // either of the above
+};
+
+// Packing several queued frames into one OFDM frame
+enum class AggregationMode {
+    OFF = 0,    // one frame per OFDM frame, plain modem73 format
+    AUTO = 1,   // aggregate while every recently heard peer supports it
+    ON = 2,     // always aggregate
+};
+
 struct TNCConfig {
     // Network settings
     std::string bind_address = "0.0.0.0";
     int port = 8001;
+    std::string unix_socket;     // Unix-domain socket path, empty = off
+    std::string shm_name;        // shared-memory ring transport name, empty = off
     
     // Audio settings
     std::string audio_input_device = "default";
     std::string audio_output_device = "default";
     int sample_rate = 48000;
+    int audio_buffer_ms = 1000;  // capture and playback ring size
     
     // Modem settings
     int center_freq = 1500;
@@ -58,6 +88,7 @@ struct TNCConfig {
     std::string modulation = "QPSK";
     std::string code_rate = "1/2";
     bool short_frame = false;  
+    bool auto_frame_length = false;   // short or normal per transmission, least airtime
     
     // PTT settings
     PTTType ptt_type = PTTType::RIGCTL;  
@@ -96,14 +127,63 @@ struct TNCConfig {
     bool csma_enabled = true;
     float carrier_threshold_db = -30.0f;
     int carrier_sense_ms = 100;
+    int rx_guard_ms = 100;       // TX lockout after a received frame, extended while the decoder hears more
+    CsmaDetect csma_detect = CsmaDetect::ENERGY;
+    bool csma_auto_threshold = false;  // threshold = noise floor + csma_margin_db
+    float csma_margin_db = 10.0f;
+    int noise_window_s = 300;          // noise floor memory
     int max_backoff_slots = 10;
     
+    // TX queue limits
+    int tx_queue_max_frames = 512;       // 0 = unlimited
+    int tx_queue_max_bytes = 4 * 1024 * 1024;  // 0 = unlimited
+    int tx_frame_ttl_ms = 60000;         // frames older than this are dropped, 0 = never
+    TxDropPolicy tx_drop_policy = TxDropPolicy::TAIL;
+    bool tx_fairness = false;            // DRR between clients, weighted by airtime
+    std::map<int, float> tx_weights;     // KISS port -> DRR weight, default 1
+    
     // Fragmentation settings
     bool fragmentation_enabled = false;
     
+    // Aggregation settings
+    AggregationMode aggregation = AggregationMode::OFF;
+    
+    // Adaptive modulation: per-peer mode choice from received SNR/FER.
+    // The configured mode is the robust fallback and is never undercut.
+    bool adaptive_mode = false;
+    float adaptive_margin_db = 3.0f;      // SNR kept in reserve above a mode's requirement
+    float adaptive_hysteresis_db = 2.0f;  // extra SNR needed before stepping up
+    
+    // Selective-repeat ARQ for fragmented packets (needs fragmentation)
+    bool arq_enabled = false;
+    int arq_window = 0;          // fragments per poll, 0 = from frame airtime
+    int arq_max_retries = 5;     // unanswered polls before a packet is given up
+    
+    // Payload compression, used while all stations heard support it
+    bool compression = false;
+    bool header_compression = false;   // AX.25 / Reticulum header contexts
+    
+    // Bulk objects: payloads of at least bulk_threshold bytes are sent 
+    // fountain coded instead of fragmented, 0 = off
+    size_t bulk_threshold = 0;
+    float bulk_overhead = 0.4f;  // repair symbols per source symbol
+    
+    // Duplicate suppression: identical payloads within dedup_window_ms are
+    // delivered to clients once (RX) or queued once (TX)
+    bool dedup_rx = false;
+    bool dedup_tx = false;
+    int dedup_window_ms = 30000;
+    
     // TX blanking
     bool tx_blanking_enabled = false;
     
+    // Real-time settings for the RX/TX threads (rt_sched.hh), best effort
+    int rt_priority = 0;         // SCHED_FIFO priority 1-99, 0 = off
+    bool rt_round_robin = false; // SCHED_RR instead of SCHED_FIFO
+    int rx_cpu = -1;             // pin the RX thread to a CPU, -1 = any
+    int tx_cpu = -1;
+    bool rt_mlock = false;       // lock memory, pre-fault the DSP buffers
+    
     // Settings file path
     std::string config_file = "";
 };
@@ -121,10 +201,18 @@ public:
         }
     }
     
-    static std::vector<uint8_t> wrap(const std::vector<uint8_t>& data, uint8_t port = 0) {
+    // Forgets a partly received frame
+    void reset() {
+        buffer_.clear();
+        in_frame_ = false;
+        escape_ = false;
+    }
+    
+    static std::vector<uint8_t> wrap(const std::vector<uint8_t>& data, uint8_t port = 0,
+                                     uint8_t cmd = KISS::CMD_DATA) {
         std::vector<uint8_t> frame;
         frame.push_back(KISS::FEND);
-        frame.push_back((port << 4) | KISS::CMD_DATA);
+        frame.push_back((port << 4) | cmd);
         
         for (uint8_t byte : data) {
             if (byte == KISS::FEND) {
@@ -180,40 +268,752 @@ private:
 };
 
 
-template<typename T>
-class PacketQueue {
+// Per-client subscription on decoded frames, set with CMD_SETHW text 
+// commands:
+//   FILTER PORT 0 3          KISS ports; received frames are all
+//                            delivered on port 0, so the list must have it
+//   FILTER CALL N0CALL K1*   source callsigns, '*' matches any suffix
+//   FILTER PREFIX 7e 16:f0   payload bytes (hex), optionally at an offset
+//   FILTER CLEAR
+// Each command replaces its kind, no arguments clears it. Empty kinds match
+// everything, a frame must match every kind that is set.
+struct RxFilter {
+    struct Prefix {
+        size_t offset = 0;
+        std::vector<uint8_t> bytes;
+    };
+    
+    uint16_t ports = 0xFFFF;   // bit per KISS port
+    std::vector<std::string> calls;
+    std::vector<Prefix> prefixes;
+    
+    bool matches(uint8_t port, const std::string& call, const uint8_t* data, size_t len) const {
+        if (!(ports & (1u << (port & 0x0F)))) return false;
+        
+        if (!calls.empty()) {
+            std::string c = normalize_call(call);
+            bool found = false;
+            for (const auto& want : calls) {
+                if (!want.empty() && want.back() == '*'
+                        ? c.compare(0, want.size() - 1, want, 0, want.size() - 1) == 0
+                        : c == want) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) return false;
+        }
+        
+        if (!prefixes.empty()) {
+            bool found = false;
+            for (const auto& p : prefixes) {
+                if (p.offset + p.bytes.size() <= len &&
+                    std::memcmp(data + p.offset, p.bytes.data(), p.bytes.size()) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) return false;
+        }
+        return true;
+    }
+    
+    // Applies one FILTER command, error explains a rejected one
+    bool apply(const std::string& command, std::string& error) {
+        std::istringstream in(command);
+        std::string word, kind;
+        in >> word >> kind;
+        std::transform(word.begin(), word.end(), word.begin(), ::toupper);
+        std::transform(kind.begin(), kind.end(), kind.begin(), ::toupper);
+        if (word != "FILTER") {
+            error = "not a FILTER command";
+            return false;
+        }
+        
+        std::vector<std::string> args;
+        for (std::string a; in >> a;) args.push_back(a);
+        
+        if (kind == "CLEAR") {
+            *this = RxFilter();
+        } else if (kind == "PORT") {
+            uint16_t mask = args.empty() ? 0xFFFF : 0;
+            for (const auto& a : args) {
+                char* end;
+                long port = std::strtol(a.c_str(), &end, 10);
+                if (*end || port < 0 || port > 15) {
+                    error = "bad port " + a;
+                    return false;
+                }
+                mask |= 1u << port;
+            }
+            if (!(mask & 1)) {
+                // Would block every frame
+                error = "port list must include 0, received frames are on port 0";
+                return false;
+            }
+            ports = mask;
+        } else if (kind == "CALL") {
+            calls.clear();
+            for (const auto& a : args) calls.push_back(normalize_call(a));
+        } else if (kind == "PREFIX") {
+            std::vector<Prefix> parsed;
+            for (const auto& a : args) {
+                Prefix p;
+                if (!parse_prefix(a, p)) {
+                    error = "bad prefix " + a;
+                    return false;
+                }
+                parsed.push_back(std::move(p));
+            }
+            prefixes = std::move(parsed);
+        } else {
+            error = "unknown filter " + kind;
+            return false;
+        }
+        return true;
+    }
+    
+private:
+    static std::string normalize_call(const std::string& call) {
+        std::string c;
+        for (char ch : call) {
+            if (ch != ' ') c.push_back(static_cast<char>(::toupper(static_cast<unsigned char>(ch))));
+        }
+        return c;
+    }
+    
+    // "hex" or "offset:hex"
+    static bool parse_prefix(const std::string& arg, Prefix& p) {
+        std::string hex = arg;
+        size_t colon = arg.find(':');
+        if (colon != std::string::npos) {
+            char* end;
+            p.offset = std::strtoul(arg.c_str(), &end, 10);
+            if (end != arg.c_str() + colon) return false;
+            hex = arg.substr(colon + 1);
+        }
+        if (hex.empty() || hex.size() % 2) return false;
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            char* end;
+            std::string byte = hex.substr(i, 2);
+            unsigned long v = std::strtoul(byte.c_str(), &end, 16);
+            if (*end) return false;
+            p.bytes.push_back(static_cast<uint8_t>(v));
+        }
+        return true;
+    }
+};
+
+
+// Recently seen payloads, for suppressing the copies digipeaters and 
+// re-announces produce. A fixed open addressing table of 64-bit hashes and
+// timestamps: no allocation after construction, a full probe window evicts
+// its oldest entry.
+class DupCache {
 public:
-    void push(T item) {
+    explicit DupCache(size_t capacity = 4096) {
+        size_t n = 64;
+        while (n < capacity) n <<= 1;
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+    
+    void configure(int window_ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_ms_ = window_ms;
+    }
+    
+    // True if the payload was first seen less than the window ago, 
+    // otherwise remembers it
+    bool check(const uint8_t* data, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return probe_locked(data, len, true);
+    }
+    
+    // Lookup only, for callers that remember() once the payload was taken
+    bool seen(const uint8_t* data, size_t len) {
         std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push(std::move(item));
+        return probe_locked(data, len, false);
     }
     
-    bool pop(T& item) {
+    void remember(const uint8_t* data, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        probe_locked(data, len, true);
+    }
+    
+    uint64_t hits() const { return hits_; }
+    
+    static uint64_t hash(const uint8_t* data, size_t len) {
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ len;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t v;
+            std::memcpy(&v, data + i, 8);
+            h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        for (; i < len; i++) {
+            h = (h ^ data[i]) * 0x100000001B3ull;
+        }
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+    
+private:
+    static constexpr size_t PROBE_LIMIT = 8;
+    
+    struct Slot {
+        uint64_t hash = 0;
+        int64_t seen_ms = 0;
+    };
+    
+    bool probe_locked(const uint8_t* data, size_t len, bool insert) {
+        uint64_t h = hash(data, len) | 1;   // 0 marks an empty slot
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        
+        Slot* victim = nullptr;
+        bool victim_live = true;
+        for (size_t i = 0; i < PROBE_LIMIT; i++) {
+            Slot& slot = slots_[(h + i) & mask_];
+            bool live = slot.hash && now - slot.seen_ms <= window_ms_;
+            if (live && slot.hash == h) {
+                hits_++;
+                return true;
+            }
+            if (!live) {
+                if (victim_live) {
+                    victim = &slot;
+                    victim_live = false;
+                }
+            } else if (victim_live && (!victim || slot.seen_ms < victim->seen_ms)) {
+                victim = &slot;
+            }
+        }
+        if (!insert) return false;
+        victim->hash = h;
+        victim->seen_ms = now;
+        return false;
+    }
+    
+    std::mutex mutex_;
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    int window_ms_ = 30000;
+    std::atomic<uint64_t> hits_{0};
+};
+
+
+// Channel level for CSMA, fed by the RX thread with every block it reads
+// and read by the TX thread without touching the capture ring. The level is
+// the RMS of the last window_ms of audio, from per-block sums of squares.
+class CarrierSense {
+public:
+    void configure(int sample_rate, int window_ms) {
+        window_samples_ = std::max<size_t>(1, size_t(sample_rate) * std::max(window_ms, 1) / 1000);
+        window_ms_ = std::max(window_ms, 1);
+        blocks_.clear();
+        samples_ = 0;
+    }
+    
+    // RX thread only
+    void feed(const float* x, size_t n) {
+        if (n == 0) return;
+        double sq = 0;
+        for (size_t i = 0; i < n; i++) sq += double(x[i]) * x[i];
+        blocks_.push_back({sq, n});
+        samples_ += n;
+        while (blocks_.size() > 1 && samples_ - blocks_.front().samples >= window_samples_) {
+            samples_ -= blocks_.front().samples;
+            blocks_.pop_front();
+        }
+        
+        // A handful of blocks; summing afresh avoids drift from subtracting
+        double sum_sq = 0;
+        for (const auto& b : blocks_) sum_sq += b.sum_sq;
+        double rms = std::sqrt(sum_sq / samples_);
+        level_db_.store(rms < 1e-10 ? -100.0f : static_cast<float>(20.0 * std::log10(rms)),
+                        std::memory_order_relaxed);
+        updated_ms_.store(now_ms(), std::memory_order_release);
+    }
+    
+    float level_db() const { return level_db_.load(std::memory_order_relaxed); }
+    
+    // True if the RX thread hasn't fed a block for longer than the window,
+    // so the level describes audio that is no longer current
+    bool stale() const {
+        int64_t updated = updated_ms_.load(std::memory_order_acquire);
+        return updated == 0 || now_ms() - updated > window_ms_ + STALE_SLACK_MS;
+    }
+    
+private:
+    static constexpr int STALE_SLACK_MS = 50;
+    
+    struct Block {
+        double sum_sq;
+        size_t samples;
+    };
+    
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    std::deque<Block> blocks_;
+    size_t samples_ = 0;
+    size_t window_samples_ = 4800;
+    int window_ms_ = 100;
+    std::atomic<float> level_db_{-100.0f};
+    std::atomic<int64_t> updated_ms_{0};
+};
+
+
+// Band noise floor from the RX level stream, for a CSMA threshold that
+// follows the band. Levels go into 0.5 dB bins whose weights decay with a
+// time constant of window_s; the floor is a low percentile, so frames and
+// bursts above it don't lift it. Fed by the RX thread, read by any.
+class NoiseFloor {
+public:
+    static constexpr float MIN_DB = -120.0f;
+    static constexpr float BIN_DB = 0.5f;
+    static constexpr int BINS = 240;
+    static constexpr float PERCENTILE = 0.2f;
+    static constexpr float WARMUP_S = 5.0f;
+    
+    void configure(int sample_rate, int window_s) {
+        sample_rate_ = std::max(sample_rate, 1);
+        window_s_ = std::max(window_s, 1);
+        bins_.fill(0.0f);
+        total_ = 0;
+        heard_s_ = 0;
+        floor_db_.store(MIN_DB, std::memory_order_relaxed);
+        ready_.store(false, std::memory_order_release);
+    }
+    
+    // level_db describes the last frames samples; RX thread only
+    void feed(float level_db, size_t frames) {
+        float dt = static_cast<float>(frames) / sample_rate_;
+        float decay = std::exp(-dt / window_s_);
+        for (auto& w : bins_) w *= decay;
+        total_ *= decay;
+        
+        int b = static_cast<int>((level_db - MIN_DB) / BIN_DB);
+        bins_[std::max(0, std::min(BINS - 1, b))] += dt;
+        total_ += dt;
+        heard_s_ += dt;
+        
+        float target = PERCENTILE * total_;
+        float sum = 0;
+        int i = 0;
+        for (; i < BINS - 1; i++) {
+            sum += bins_[i];
+            if (sum >= target) break;
+        }
+        floor_db_.store(MIN_DB + (i + 0.5f) * BIN_DB, std::memory_order_relaxed);
+        if (heard_s_ >= WARMUP_S) ready_.store(true, std::memory_order_release);
+    }
+    
+    // False until WARMUP_S of audio has been heard
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+    float floor_db() const { return floor_db_.load(std::memory_order_relaxed); }
+    
+private:
+    std::array<float, BINS> bins_{};
+    float total_ = 0;
+    float heard_s_ = 0;
+    int sample_rate_ = 48000;
+    int window_s_ = 300;
+    std::atomic<float> floor_db_{MIN_DB};
+    std::atomic<bool> ready_{false};
+};
+
+
+// ACKMODE tag: who to tell once the frame has left the radio
+struct TxAck {
+    static constexpr uint64_t LOCAL = ~uint64_t(0);   // in-process submitter
+    
+    uint64_t client = 0;   // 0 = no ack requested
+    uint8_t port = 0;
+    uint16_t id = 0;
+};
+
+// Bounded TX queue with per-batch TTL 
+// Frames belonging together (fragment trains) are pushed as one batch so a 
+// full queue never keeps half of a packet. Likewise the TTL expires whole 
+// batches, and only until the first frame of one is sent: from then on the 
+// rest goes out too, half a packet on air is wasted airtime.
+//
+// With fairness on, every flow (a KISS client and port) has its own FIFO and
+// the flows are served by deficit round robin: each turn a flow earns
+// quantum * weight of airtime credit and sends frames while the credit
+// covers their airtime. A bulk upload then can't starve a beacon client.
+struct TxFrame {
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::time_point enqueued;
+    uint8_t flags = 0;   // Ext entry flags, non-zero needs an aggregate frame
+    TxAck ack;
+    float airtime = 0;   // DRR cost, seconds
+    uint64_t batch = 0;  // push_batch() it came from, dropped together
+    uint32_t batch_left = 0;     // frames of the batch queued behind it
+    bool batch_started = false;  // an earlier frame of the batch was sent, no TTL
+};
+
+// Who a frame is queued for
+struct TxFlow {
+    uint64_t id = 0;        // 0 = the TNC itself
+    float weight = 1.0f;    // share of airtime relative to other flows
+};
+
+class TxQueue {
+public:
+    void configure(size_t max_frames, size_t max_bytes, int ttl_ms, TxDropPolicy policy) {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
+        max_frames_ = max_frames;
+        max_bytes_ = max_bytes;
+        ttl_ms_ = ttl_ms;
+        policy_ = policy;
+    }
+    
+    // airtime(bytes) is what a frame costs in seconds; airtime(SIZE_MAX) is
+    // taken as a full frame and used as the DRR quantum. Disabled, all flows
+    // share one FIFO.
+    void configure_fairness(bool enabled, std::function<float(size_t)> airtime) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fair_ = enabled;
+        airtime_ = std::move(airtime);
+    }
+    
+    bool push(std::vector<uint8_t> data, uint8_t flags = 0, const TxAck& ack = TxAck(),
+              const TxFlow& flow = TxFlow()) {
+        std::vector<std::vector<uint8_t>> batch;
+        batch.push_back(std::move(data));
+        return push_batch(std::move(batch), false, flags, ack, flow);
+    }
+    
+    // All or nothing: returns false if the batch was dropped. front puts the
+    // batch ahead of everything queued (retransmissions), in order. ack goes
+    // with the last frame, the packet is on air once that one is.
+    bool push_batch(std::vector<std::vector<uint8_t>> frames, bool front = false, uint8_t flags = 0,
+                    const TxAck& ack = TxAck(), const TxFlow& flow = TxFlow()) {
+        size_t batch_bytes = 0;
+        for (const auto& f : frames) batch_bytes += f.size();
+        
+        std::function<float(size_t)> airtime;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fair_) airtime = airtime_;
+        }
+        // Outside the lock, the cost model may take its own locks
+        std::vector<float> costs(frames.size(), 0.0f);
+        float quantum = 0;
+        if (airtime) {
+            for (size_t i = 0; i < frames.size(); i++) costs[i] = airtime(frames[i].size());
+            quantum = airtime(SIZE_MAX);
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        
+        if ((max_frames_ && frames.size() > max_frames_) || (max_bytes_ && batch_bytes > max_bytes_)) {
+            dropped_full_ += frames.size();
+            return false;
+        }
+        
+        while (!fits(frames.size(), batch_bytes)) {
+            if (policy_ == TxDropPolicy::TAIL || count_ == 0) {
+                dropped_full_ += frames.size();
+                return false;
+            }
+            dropped_full_ += drop_oldest_locked();
+        }
+        
+        if (quantum > 0) quantum_ = quantum;
+        
+        std::deque<TxFrame>* target = &urgent_;
+        if (!front) {
+            uint64_t id = airtime ? flow.id : 0;
+            Flow& f = flows_[id];
+            if (!f.active) {
+                active_.push_back(id);
+                f.active = true;
+            }
+            f.weight = std::max(flow.weight, MIN_WEIGHT);
+            f.bytes += batch_bytes;
+            target = &f.frames;
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        auto pos = front ? target->begin() : target->end();
+        uint64_t batch = ++next_batch_;
+        for (size_t i = 0; i < frames.size(); i++) {
+            bytes_ += frames[i].size();
+            TxAck tag = i + 1 == frames.size() ? ack : TxAck();
+            uint32_t left = static_cast<uint32_t>(frames.size() - i - 1);
+            pos = target->insert(pos, {std::move(frames[i]), now, flags, tag, costs[i], batch, left}) + 1;
+        }
+        count_ += frames.size();
         return true;
     }
     
+    // Pops the next frame that has not yet expired: retransmissions first,
+    // then the flows in DRR order
+    bool pop(TxFrame& frame) {
+        return pop_if_fits(SIZE_MAX, frame);
+    }
+    
+    // Same as pop(), but leaves the next frame queued if it is larger than 
+    // max_size
+    bool pop_if_fits(size_t max_size, TxFrame& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        
+        drop_expired_locked(urgent_, nullptr, now);
+        if (!urgent_.empty()) {
+            if (urgent_.front().data.size() > max_size) return false;
+            take_locked(urgent_, nullptr, frame, now);
+            return true;
+        }
+        
+        while (!active_.empty()) {
+            uint64_t id = active_.front();
+            Flow& f = flows_[id];
+            drop_expired_locked(f.frames, &f, now);
+            if (f.frames.empty()) {
+                active_.pop_front();
+                flows_.erase(id);
+                continue;
+            }
+            
+            // A new turn earns the quantum once
+            if (!f.in_turn) {
+                f.deficit += quantum_ * f.weight;
+                f.in_turn = true;
+            }
+            
+            TxFrame& head = f.frames.front();
+            if (head.airtime <= f.deficit) {
+                if (head.data.size() > max_size) return false;
+                f.deficit -= head.airtime;
+                take_locked(f.frames, &f, frame, now);
+                if (f.frames.empty()) {
+                    // Idle flows don't bank credit
+                    active_.pop_front();
+                    flows_.erase(id);
+                }
+                return true;
+            }
+            
+            f.in_turn = false;
+            active_.pop_front();
+            active_.push_back(id);
+        }
+        return false;
+    }
+    
+    // For a popped frame that may have aged out while waiting for the
+    // channel: true if it did, then the rest of its batch is dropped along
+    // with it (their acks go to take_lost_acks()). Counted as expired.
+    bool expire(const TxFrame& frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_expired_locked(frame, std::chrono::steady_clock::now())) return false;
+        size_t left = frame.batch_left;
+        left -= drop_batch_locked(urgent_, nullptr, frame.batch, left);
+        for (auto it = flows_.begin(); left > 0 && it != flows_.end(); ++it) {
+            left -= drop_batch_locked(it->second.frames, &it->second, frame.batch, left);
+        }
+        dropped_expired_ += 1 + frame.batch_left - left;
+        return true;
+    }
+    
+    void count_expired() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dropped_expired_++;
+    }
+    
     bool empty() const {
         std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
+        return count_ == 0;
     }
     
     size_t size() const {
         std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+        return count_;
+    }
+    
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+    
+    // Flows with frames queued
+    size_t flows() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return active_.size();
     }
     
     void clear() {
         std::lock_guard<std::mutex> lock(mutex_);
-        while (!queue_.empty()) queue_.pop();
+        urgent_.clear();
+        flows_.clear();
+        active_.clear();
+        count_ = 0;
+        bytes_ = 0;
+    }
+    
+    uint64_t dropped_full() const { return dropped_full_; }
+    uint64_t dropped_expired() const { return dropped_expired_; }
+    
+    // Acks of frames dropped unsent (TTL, head drop) since the last call
+    std::vector<TxAck> take_lost_acks() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<TxAck> acks;
+        acks.swap(lost_acks_);
+        return acks;
+    }
+    
+    // Queue age (ms) at dequeue over the last AGE_SAMPLES frames
+    void age_percentiles(int& p50, int& p90, int& p99) const {
+        std::vector<int> ages;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ages.assign(ages_, ages_ + age_count_);
+        }
+        if (ages.empty()) {
+            p50 = p90 = p99 = 0;
+            return;
+        }
+        std::sort(ages.begin(), ages.end());
+        auto pct = [&ages](int p) { return ages[(ages.size() - 1) * p / 100]; };
+        p50 = pct(50);
+        p90 = pct(90);
+        p99 = pct(99);
     }
     
 private:
+    static constexpr size_t AGE_SAMPLES = 256;
+    static constexpr float MIN_WEIGHT = 0.01f;
+    
+    struct Flow {
+        std::deque<TxFrame> frames;
+        size_t bytes = 0;
+        float weight = 1.0f;
+        float deficit = 0;
+        bool in_turn = false;
+        bool active = false;   // listed in active_
+    };
+    
+    bool fits(size_t frames, size_t bytes) const {
+        if (max_frames_ && count_ + frames > max_frames_) return false;
+        if (max_bytes_ && bytes_ + bytes > max_bytes_) return false;
+        return true;
+    }
+    
+    bool is_expired_locked(const TxFrame& frame, std::chrono::steady_clock::time_point now) const {
+        return ttl_ms_ > 0 && !frame.batch_started && now - frame.enqueued > std::chrono::milliseconds(ttl_ms_);
+    }
+    
+    void take_locked(std::deque<TxFrame>& q, Flow* flow, TxFrame& frame,
+                     std::chrono::steady_clock::time_point now) {
+        frame = std::move(q.front());
+        q.pop_front();
+        bytes_ -= frame.data.size();
+        if (flow) flow->bytes -= frame.data.size();
+        count_--;
+        record_age(now - frame.enqueued);
+        
+        // The rest of the batch is committed now. Usually right behind it,
+        // a retransmission pushed to the front may sit in between.
+        uint32_t left = frame.batch_left;
+        for (auto it = q.begin(); left > 0 && it != q.end(); ++it) {
+            if (it->batch == frame.batch) {
+                it->batch_started = true;
+                left--;
+            }
+        }
+    }
+    
+    // All frames of a batch expire at once, they were queued together
+    void drop_expired_locked(std::deque<TxFrame>& q, Flow* flow, std::chrono::steady_clock::time_point now) {
+        while (!q.empty() && is_expired_locked(q.front(), now)) {
+            // An unstarted head is the first of its batch
+            const TxFrame& head = q.front();
+            dropped_expired_ += drop_batch_locked(q, flow, head.batch, head.batch_left + 1);
+        }
+    }
+    
+    // Removes up to count frames of one batch from q, returns how many
+    size_t drop_batch_locked(std::deque<TxFrame>& q, Flow* flow, uint64_t batch, size_t count) {
+        size_t dropped = 0;
+        for (auto it = q.begin(); dropped < count && it != q.end();) {
+            if (it->batch != batch) {
+                ++it;
+                continue;
+            }
+            if (it->ack.client) lost_acks_.push_back(it->ack);
+            bytes_ -= it->data.size();
+            if (flow) flow->bytes -= it->data.size();
+            count_--;
+            it = q.erase(it);
+            dropped++;
+        }
+        return dropped;
+    }
+    
+    // Head drop: the oldest batch of the flow holding the most bytes, so 
+    // the client causing the overflow pays for it. Whole batches, a 
+    // fragment train is useless without the rest. Returns frames dropped.
+    size_t drop_oldest_locked() {
+        Flow* victim = nullptr;
+        for (auto& kv : flows_) {
+            if (!kv.second.frames.empty() && (!victim || kv.second.bytes > victim->bytes)) {
+                victim = &kv.second;
+            }
+        }
+        std::deque<TxFrame>& q = victim ? victim->frames : urgent_;
+        uint64_t batch = q.front().batch;
+        size_t dropped = 0;
+        while (!q.empty() && q.front().batch == batch) {
+            if (q.front().ack.client) lost_acks_.push_back(q.front().ack);
+            bytes_ -= q.front().data.size();
+            if (victim) victim->bytes -= q.front().data.size();
+            count_--;
+            q.pop_front();
+            dropped++;
+        }
+        return dropped;
+    }
+    
+    void record_age(std::chrono::steady_clock::duration age) {
+        ages_[age_pos_] = std::chrono::duration_cast<std::chrono::milliseconds>(age).count();
+        age_pos_ = (age_pos_ + 1) % AGE_SAMPLES;
+        if (age_count_ < AGE_SAMPLES) age_count_++;
+    }
+    
     mutable std::mutex mutex_;
-    std::queue<T> queue_;
+    std::deque<TxFrame> urgent_;           // retransmissions, ahead of all flows
+    std::map<uint64_t, Flow> flows_;
+    std::deque<uint64_t> active_;          // DRR order of flows with frames
+    size_t count_ = 0;
+    size_t bytes_ = 0;
+    uint64_t next_batch_ = 0;
+    std::vector<TxAck> lost_acks_;
+    
+    bool fair_ = false;
+    std::function<float(size_t)> airtime_;
+    float quantum_ = 1.0f;
+    
+    size_t max_frames_ = 0;
+    size_t max_bytes_ = 0;
+    int ttl_ms_ = 0;
+    TxDropPolicy policy_ = TxDropPolicy::TAIL;
+    
+    std::atomic<uint64_t> dropped_full_{0};
+    std::atomic<uint64_t> dropped_expired_{0};
+    
+    int ages_[AGE_SAMPLES] = {};
+    size_t age_pos_ = 0;
+    size_t age_count_ = 0;
 };
 
 
@@ -378,13 +1178,375 @@ inline std::vector<uint8_t> unframe_length(const uint8_t* data, size_t total_len
     return std::vector<uint8_t>(data + 2, data + 2 + payload_len);
 }
 
+// Extension frames
+// A zero length prefix makes plain modem73 peers discard the frame in
+// unframe_length(), so extensions are carried in what would otherwise be 
+// padding:  [00 00] [MAGIC] [sender caps] [type] [body...]
+namespace Ext {
+    constexpr uint8_t MAGIC = 0xE7;
+    constexpr size_t HEADER_SIZE = 5;
+    
+    // Frame types
+    constexpr uint8_t TYPE_HELLO     = 0x01;  // capability announcement, no body
+    constexpr uint8_t TYPE_AGGREGATE = 0x02;  // several entries, see below
+    constexpr uint8_t TYPE_ARQ_STATUS = 0x03; // missing fragments, see Arq
+    constexpr uint8_t TYPE_FOUNTAIN  = 0x04;  // bulk object symbol, see fountain.hh
+    constexpr uint8_t TYPE_HC_NACK   = 0x05;  // unknown header context, see HdrComp
+    
+    // Capability bits
+    constexpr uint8_t CAP_AGGREGATE = 0x01;
+    constexpr uint8_t CAP_ARQ       = 0x02;
+    constexpr uint8_t CAP_COMPRESS  = 0x04;
+    constexpr uint8_t CAP_HDRCOMP   = 0x08;
+    constexpr uint8_t CAP_BULK      = 0x10;   // decodes TYPE_FOUNTAIN objects
+    
+    // Aggregate body: entries of [flags:2 | length:14] [data], ended by a
+    // zero length entry (the encoder's zero padding) or the end of the frame
+    constexpr size_t ENTRY_HEADER_SIZE = 2;
+    constexpr uint16_t ENTRY_LEN_MASK = 0x3FFF;
+    constexpr uint8_t ENTRY_HDRCOMP    = 0x01;   // see HdrComp
+    constexpr uint8_t ENTRY_COMPRESSED = 0x02;   // see compress.hh
+    
+    // Call signs in extension bodies, as ModemConfig::encode_callsign()
+    constexpr size_t CALL_SIZE = 6;
+    
+    constexpr int HELLO_INTERVAL_MS = 60000;
+    constexpr int PEER_WINDOW_MS = 15 * 60 * 1000;
+    
+    inline std::vector<uint8_t> header(uint8_t caps, uint8_t type) {
+        return {0x00, 0x00, MAGIC, caps, type};
+    }
+    
+    inline void put_call(std::vector<uint8_t>& frame, int64_t call) {
+        for (int shift = 40; shift >= 0; shift -= 8) {
+            frame.push_back((call >> shift) & 0xFF);
+        }
+    }
+    
+    inline int64_t get_call(const uint8_t* p) {
+        int64_t call = 0;
+        for (size_t i = 0; i < CALL_SIZE; i++) {
+            call = (call << 8) | p[i];
+        }
+        return call;
+    }
+    
+    inline bool is_ext_frame(const uint8_t* data, size_t len) {
+        return len >= HEADER_SIZE && data[0] == 0x00 && data[1] == 0x00 && data[2] == MAGIC;
+    }
+    
+    // Appends one entry if it fits within capacity (the OFDM payload size)
+    inline bool append_entry(std::vector<uint8_t>& frame, const std::vector<uint8_t>& entry,
+                             size_t capacity, uint8_t flags = 0) {
+        if (entry.empty() || entry.size() > ENTRY_LEN_MASK) return false;
+        if (frame.size() + ENTRY_HEADER_SIZE + entry.size() > capacity) return false;
+        uint16_t hdr = (uint16_t(flags & 0x03) << 14) | uint16_t(entry.size());
+        frame.push_back((hdr >> 8) & 0xFF);
+        frame.push_back(hdr & 0xFF);
+        frame.insert(frame.end(), entry.begin(), entry.end());
+        return true;
+    }
+    
+    struct Entry {
+        uint8_t flags;
+        std::vector<uint8_t> data;
+    };
+    
+    // Splits an aggregate body; returns false if the entry lengths don't add up
+    inline bool split_entries(const uint8_t* body, size_t len, std::vector<Entry>& out) {
+        size_t pos = 0;
+        while (pos + ENTRY_HEADER_SIZE <= len) {
+            uint16_t hdr = (body[pos] << 8) | body[pos + 1];
+            size_t entry_len = hdr & ENTRY_LEN_MASK;
+            if (entry_len == 0) break;
+            pos += ENTRY_HEADER_SIZE;
+            if (pos + entry_len > len) return false;
+            out.push_back({uint8_t(hdr >> 14), std::vector<uint8_t>(body + pos, body + pos + entry_len)});
+            pos += entry_len;
+        }
+        return !out.empty();
+    }
+}
+
+// Mode properties without going through Common::setup(), which logs.
+// Mirrors the tables in phy/common.hh.
+namespace Modes {
+    struct Info {
+        int data_bytes;
+        int symbol_count;
+        float duration;   // seconds on air, preamble and meta symbol included
+    };
+    
+    inline int modulation(int mode) { return (mode >> 4) & 7; }
+    inline int code_rate(int mode) { return (mode >> 1) & 7; }
+    inline bool is_normal(int mode) { return mode & 1; }
+    
+    inline bool info(int mode, Info& out) {
+        static const int base_symbols[8] = {8, 4, 11, 4, 11, 8, 13, 11};
+        static const int base_order[8] = {11, 11, 13, 12, 14, 14, 15, 15};
+        static const int bits_at_order_11[5] = {1024, 1368, 1536, 1704, 512};
+        
+        if (mode < 0 || (mode & 128) || code_rate(mode) > 4) return false;
+        int symbols = base_symbols[modulation(mode)];
+        int order = base_order[modulation(mode)];
+        if (is_normal(mode)) {
+            if (symbols == 4) {
+                symbols *= 4;
+                order += 2;
+            } else {
+                symbols *= 2;
+                ++order;
+            }
+        }
+        out.data_bytes = (bits_at_order_11[code_rate(mode)] << (order - 11)) / 8;
+        out.symbol_count = symbols;
+        out.duration = 41.0f / 300.0f * (3 + symbols);
+        return true;
+    }
+    
+    // Rough decoder SNR (dB, as reported by get_last_snr()) needed for a 
+    // clean decode. Columns: 1/2, 2/3, 3/4, 5/6, 1/4
+    inline float required_snr(int mode) {
+        static const float table[8][5] = {
+            { 1,  3,  4,  5, -2},   // BPSK
+            { 4,  6,  7,  8,  1},   // QPSK
+            { 8, 10, 11, 13,  5},   // 8PSK
+            {10, 12, 13, 15,  6},   // QAM16
+            {15, 18, 19, 21, 11},   // QAM64
+            {20, 23, 25, 27, 16},   // QAM256
+            {25, 28, 30, 32, 21},   // QAM1024
+            {30, 33, 35, 37, 26},   // QAM4096
+        };
+        return table[modulation(mode)][std::min(code_rate(mode), 4)];
+    }
+    
+    inline std::string name(int mode) {
+        static const char* mods[8] = {"BPSK", "QPSK", "8PSK", "QAM16", "QAM64", "QAM256", "QAM1024", "QAM4096"};
+        static const char* rates[5] = {"1/2", "2/3", "3/4", "5/6", "1/4"};
+        return std::string(mods[modulation(mode)]) + " " + rates[std::min(code_rate(mode), 4)] +
+               (is_normal(mode) ? " N" : " S");
+    }
+    
+    // Fastest way to move backlog_bytes: the mode with the least total airtime
+    // among those no more demanding than ceiling_db. Only modes with the same 
+    // frame length and at least the base payload are considered, so anything 
+    // queued for base_mode still fits.
+    inline int select(int base_mode, size_t backlog_bytes, float ceiling_db) {
+        Info base;
+        if (!info(base_mode, base)) return base_mode;
+        
+        auto cost = [backlog_bytes](const Info& in) {
+            size_t per_frame = in.data_bytes - 2;
+            return ((backlog_bytes + per_frame - 1) / per_frame) * in.duration;
+        };
+        
+        int best = base_mode;
+        float best_cost = cost(base);
+        for (int mod = 0; mod < 8; ++mod) {
+            for (int rate = 0; rate < 5; ++rate) {
+                int mode = (mod << 4) | (rate << 1) | (base_mode & 1);
+                Info in;
+                if (!info(mode, in) || in.data_bytes < base.data_bytes) continue;
+                if (required_snr(mode) > ceiling_db) continue;
+                float c = cost(in);
+                if (c < best_cost || (c == best_cost && required_snr(mode) < required_snr(best))) {
+                    best = mode;
+                    best_cost = c;
+                }
+            }
+        }
+        return best;
+    }
+    
+    // Short or normal frames for one transmission, same modulation and code
+    // rate: whichever moves the backlog (frames queued, bytes in total, the
+    // first of first_bytes) in the least airtime. overhead_s is what every
+    // transmission costs on top of the frame (TXDelay, PTT, VOX tones).
+    // Without aggregation only the first frame goes, so the shortest frame
+    // it fits in wins. Ties keep the configured length.
+    inline int pick_length(int mode, size_t first_bytes, size_t frames, size_t backlog_bytes,
+                           bool aggregate, float overhead_s) {
+        int best = mode;
+        float best_cost = 0;
+        bool found = false;
+        for (int i = 0; i < 2; i++) {
+            int m = i == 0 ? mode : mode ^ 1;
+            Info in;
+            size_t first_size = first_bytes + (aggregate ? Ext::HEADER_SIZE + Ext::ENTRY_HEADER_SIZE : 2);
+            if (!info(m, in) || first_size > static_cast<size_t>(in.data_bytes)) continue;
+            
+            float cost = in.duration + overhead_s;
+            if (aggregate) {
+                size_t per_tx = in.data_bytes - Ext::HEADER_SIZE;
+                size_t need = backlog_bytes + frames * Ext::ENTRY_HEADER_SIZE;
+                cost *= static_cast<float>((need + per_tx - 1) / per_tx);
+            }
+            if (!found || cost < best_cost) {
+                best = m;
+                best_cost = cost;
+                found = true;
+            }
+        }
+        return best;
+    }
+    
+    // Required SNR levels, ascending; the steps the adaptive ceiling moves on
+    inline const std::vector<float>& levels() {
+        static const std::vector<float> lv = [] {
+            std::vector<float> v;
+            for (int mode = 0; mode < 128; mode += 2) {
+                if (code_rate(mode) > 4) continue;
+                v.push_back(required_snr(mode));
+            }
+            std::sort(v.begin(), v.end());
+            v.erase(std::unique(v.begin(), v.end()), v.end());
+            return v;
+        }();
+        return lv;
+    }
+}
+
+// Destination call sign of an AX.25 frame, without SSID; empty if the 
+// payload doesn't look like AX.25
+inline std::string ax25_dest_call(const std::vector<uint8_t>& payload) {
+    if (payload.size() < 15) return "";
+    std::string call;
+    for (int i = 0; i < 6; ++i) {
+        if (payload[i] & 1) return "";
+        char c = payload[i] >> 1;
+        if (c == ' ') continue;
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) return "";
+        call += c;
+    }
+    return call;
+}
+
+// Stations heard on the channel, keyed by the call sign from the meta symbol
+class PeerTable {
+public:
+    void set_caps(const std::string& call, uint8_t caps) {
+        if (call.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& peer = peers_[call];
+        peer.caps = caps;
+        peer.caps_known = true;
+    }
+    
+    // True if at least one peer was heard recently and all of them have cap
+    bool all_capable(uint8_t cap, int window_ms = Ext::PEER_WINDOW_MS) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cutoff = std::chrono::steady_clock::now() - std::chrono::milliseconds(window_ms);
+        bool any = false;
+        for (const auto& kv : peers_) {
+            if (kv.second.last_heard < cutoff) continue;
+            if (!kv.second.caps_known || !(kv.second.caps & cap)) return false;
+            any = true;
+        }
+        return any;
+    }
+    
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return peers_.size();
+    }
+    
+    // Link quality from one received frame. snr_db is only meaningful when 
+    // ok; failed frames only feed the frame error rate. Returns true the
+    // first time a call sign is heard.
+    bool update_link(const std::string& call, bool ok, float snr_db, float margin_db, float hysteresis_db) {
+        if (call.empty()) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool is_new = peers_.find(call) == peers_.end();
+        auto& peer = peers_[call];
+        peer.last_heard = std::chrono::steady_clock::now();
+        peer.fer = FER_ALPHA * (ok ? 0.0f : 1.0f) + (1 - FER_ALPHA) * peer.fer;
+        if (ok) {
+            peer.snr_db = peer.has_snr ? SNR_ALPHA * snr_db + (1 - SNR_ALPHA) * peer.snr_db : snr_db;
+            peer.has_snr = true;
+        }
+        if (!peer.has_snr) return is_new;
+        
+        float usable = peer.snr_db - margin_db;
+        if (peer.fer > FER_LIMIT) usable -= FER_PENALTY_DB;
+        
+        const auto& lv = Modes::levels();
+        if (!peer.has_ceiling) {
+            // First measurement: highest level it supports
+            peer.ceiling_db = lv.front() - 1;
+            for (float l : lv) if (l <= usable) peer.ceiling_db = l;
+            peer.has_ceiling = true;
+            return is_new;
+        }
+        if (peer.ceiling_db > usable) {
+            // Step down as far as needed at once
+            float c = lv.front() - 1;
+            for (float l : lv) if (l <= usable) c = l;
+            peer.ceiling_db = c;
+        } else {
+            // Step up one level at a time, and only with hysteresis to spare
+            auto next = std::upper_bound(lv.begin(), lv.end(), peer.ceiling_db);
+            if (next != lv.end() && usable >= *next + hysteresis_db) {
+                peer.ceiling_db = *next;
+            }
+        }
+        return is_new;
+    }
+    
+    // Required-SNR ceiling for traffic to dest. Unknown destinations (and 
+    // broadcasts) get the weakest recently heard station. Returns -inf, i.e.
+    // the configured mode only, while nothing is known.
+    float ceiling_for(const std::string& dest, int window_ms = Ext::PEER_WINDOW_MS) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cutoff = std::chrono::steady_clock::now() - std::chrono::milliseconds(window_ms);
+        
+        auto it = dest.empty() ? peers_.end() : peers_.find(dest);
+        if (it != peers_.end() && it->second.last_heard >= cutoff) {
+            return it->second.has_ceiling ? it->second.ceiling_db : -INFINITY;
+        }
+        
+        float ceiling = INFINITY;
+        for (const auto& kv : peers_) {
+            if (kv.second.last_heard < cutoff) continue;
+            if (!kv.second.has_ceiling) return -INFINITY;
+            ceiling = std::min(ceiling, kv.second.ceiling_db);
+        }
+        return std::isinf(ceiling) ? -INFINITY : ceiling;
+    }
+    
+private:
+    static constexpr float SNR_ALPHA = 0.3f;
+    static constexpr float FER_ALPHA = 0.2f;
+    static constexpr float FER_LIMIT = 0.3f;
+    static constexpr float FER_PENALTY_DB = 3.0f;
+    
+    struct Peer {
+        std::chrono::steady_clock::time_point last_heard;
+        uint8_t caps = 0;
+        bool caps_known = false;
+        
+        // Adaptive modulation
+        float snr_db = 0;
+        float fer = 0;
+        bool has_snr = false;
+        float ceiling_db = 0;   // most demanding required SNR currently allowed
+        bool has_ceiling = false;
+    };
+    
+    std::map<std::string, Peer> peers_;
+    mutable std::mutex mutex_;
+};
+
 namespace Frag {
     constexpr uint8_t MAGIC = 0xF3;
     constexpr size_t HEADER_SIZE = 5;
     constexpr uint8_t FLAG_MORE_FRAGMENTS = 0x01;
     constexpr uint8_t FLAG_FIRST_FRAGMENT = 0x02;
+    constexpr uint8_t FLAG_ARQ = 0x04;    // sender wants status reports
+    constexpr uint8_t FLAG_POLL = 0x08;   // report status now
+    constexpr uint8_t FLAG_COMPRESSED = 0x10;   // reassembled packet is compressed
     constexpr int REASSEMBLY_TIMEOUT_MS = 30000;
     constexpr size_t MAX_PENDING_PACKETS = 64;
+    constexpr size_t MAX_PACKET_BYTES = 1024 * 1024;   // per reassembly slot
 }
 
 class Fragmenter {
@@ -438,65 +1600,95 @@ private:
     std::atomic<uint16_t> next_packet_id_;
 };
 
+// Reassembly in a fixed set of slots. Fragments are copied straight to
+// seq * fragment size in the slot's buffer, a bitmap tracks what arrived,
+// and a timer wheel with one second buckets expires stale packets. Slot
+// buffers are kept for reuse, so memory stays bounded by 
+// MAX_PENDING_PACKETS * MAX_PACKET_BYTES and steady state allocates nothing.
 class Reassembler {
 public:
-    Reassembler() = default;
+    Reassembler() : index_(65536, -1), slots_(Frag::MAX_PENDING_PACKETS) {
+        buckets_.fill(-1);
+        free_.reserve(slots_.size());
+        for (int i = static_cast<int>(slots_.size()) - 1; i >= 0; i--) free_.push_back(i);
+        wheel_tick_ = now_tick();
+    }
     
     std::vector<uint8_t> process(const std::vector<uint8_t>& fragment) {
-        if (fragment.size() < Frag::HEADER_SIZE) {
-            return {};
-        }
-        
-        if (fragment[0] != Frag::MAGIC) {
+        if (!is_fragment(fragment)) {
             return {};
         }
         
         uint16_t packet_id = (fragment[1] << 8) | fragment[2];
         uint8_t seq = fragment[3];
         uint8_t flags = fragment[4];
-        
-        std::vector<uint8_t> payload(fragment.begin() + Frag::HEADER_SIZE, fragment.end());
+        bool last = !(flags & Frag::FLAG_MORE_FRAGMENTS);
+        const uint8_t* payload = fragment.data() + Frag::HEADER_SIZE;
+        size_t len = fragment.size() - Frag::HEADER_SIZE;
         
         std::lock_guard<std::mutex> lock(mutex_);
         
-        cleanup_stale();
-        
-        auto& pkt = pending_[packet_id];
-        if (pkt.fragments.empty()) {
-            pkt.first_seen = std::chrono::steady_clock::now();
-        }
+        uint32_t now = now_tick();
+        advance_wheel(now);
         
-        pkt.fragments[seq] = std::move(payload);
+        int s = index_[packet_id];
+        if (s < 0) s = alloc_slot(packet_id);
+        Slot& slot = slots_[s];
         
-        if (flags & Frag::FLAG_FIRST_FRAGMENT) {
-            pkt.has_first = true;
-        }
+        // Expiry counts from the latest fragment, ARQ retransmissions keep
+        // a slow packet alive
+        schedule(s, now + TIMEOUT_TICKS);
         
-        if (!(flags & Frag::FLAG_MORE_FRAGMENTS)) {
-            pkt.last_seq = seq;
-            pkt.has_last = true;
-        }
+        if (has_bit(slot, seq)) return {};
+        if (slot.has_last && (seq > slot.last_seq || last)) return {};
         
-        if (pkt.has_first && pkt.has_last) {
-            bool complete = true;
-            for (uint8_t i = 0; i <= pkt.last_seq; i++) {
-                if (pkt.fragments.find(i) == pkt.fragments.end()) {
-                    complete = false;
-                    break;
-                }
+        if (last) {
+            // Fragments past the end belong to another packet under the same
+            // id (or are garbage); counting them would complete a packet
+            // with a hole
+            if (any_bit_above(slot, seq)) {
+                release(s);
+                return {};
             }
-            
-            if (complete) {
-                std::vector<uint8_t> reassembled;
-                for (uint8_t i = 0; i <= pkt.last_seq; i++) {
-                    auto& frag_data = pkt.fragments[i];
-                    reassembled.insert(reassembled.end(), frag_data.begin(), frag_data.end());
+            if (slot.frag_size == 0 && seq > 0) {
+                // Offset unknown until a full-size fragment shows up
+                slot.tail.assign(payload, payload + len);
+                slot.tail_pending = true;
+            } else if (!place(slot, seq * size_t(slot.frag_size), payload, len)) {
+                return {};
+            }
+            slot.has_last = true;
+            slot.last_seq = seq;
+            slot.last_len = static_cast<uint16_t>(len);
+        } else {
+            if (slot.frag_size == 0) {
+                if (len == 0 || len > UINT16_MAX) return {};
+                slot.frag_size = static_cast<uint16_t>(len);
+                if (slot.tail_pending) {
+                    if (!place(slot, slot.last_seq * size_t(slot.frag_size), slot.tail.data(), slot.tail.size())) {
+                        release(s);
+                        return {};
+                    }
+                    slot.tail_pending = false;
                 }
-                pending_.erase(packet_id);
-                return reassembled;
+            } else if (len != slot.frag_size) {
+                return {};
+            }
+            if (!place(slot, seq * size_t(slot.frag_size), payload, len)) {
+                return {};
             }
         }
         
+        set_bit(slot, seq);
+        slot.count++;
+        
+        if (slot.has_last && slot.count == slot.last_seq + 1) {
+            size_t total = slot.last_seq * size_t(slot.frag_size) + slot.last_len;
+            std::vector<uint8_t> reassembled(slot.data.begin(), slot.data.begin() + total);
+            release(s);
+            return reassembled;
+        }
+        
         return {};
     }
     
@@ -507,41 +1699,662 @@ public:
     
     void reset() {
         std::lock_guard<std::mutex> lock(mutex_);
-        pending_.clear();
+        for (size_t i = 0; i < slots_.size(); i++) {
+            if (slots_[i].in_use) release(static_cast<int>(i));
+        }
+    }
+    
+    // Fragments of a pending packet not received yet, as a bitmap (bit i of
+    // byte i/8 set = seq i missing). count runs to the last fragment once it
+    // has been seen, else to the highest one received.
+    bool missing(uint16_t packet_id, uint8_t& count, bool& last_known, std::vector<uint8_t>& bitmap) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int s = index_[packet_id];
+        if (s < 0 || slots_[s].count == 0) return false;
+        const Slot& slot = slots_[s];
+        last_known = slot.has_last;
+        if (slot.has_last) {
+            count = slot.last_seq + 1;
+        } else {
+            int highest = 0;
+            for (int w = 3; w >= 0; w--) {
+                if (slot.received[w]) {
+                    highest = w * 64 + 63 - clz64(slot.received[w]);
+                    break;
+                }
+            }
+            count = static_cast<uint8_t>(highest + 1);
+        }
+        bitmap.assign((count + 7) / 8, 0);
+        for (int i = 0; i < count; i++) {
+            if (!has_bit(slot, i)) {
+                bitmap[i / 8] |= 1 << (i % 8);
+            }
+        }
+        return true;
     }
     
 private:
-    struct PendingPacket {
-        std::map<uint8_t, std::vector<uint8_t>> fragments;
-        std::chrono::steady_clock::time_point first_seen;
+    static constexpr uint32_t TICK_MS = 1000;
+    static constexpr uint32_t TIMEOUT_TICKS = (Frag::REASSEMBLY_TIMEOUT_MS + TICK_MS - 1) / TICK_MS;
+    static constexpr size_t WHEEL_SIZE = 32;
+    static_assert(WHEEL_SIZE > TIMEOUT_TICKS, "timer wheel must cover the reassembly timeout");
+    
+    struct Slot {
+        std::vector<uint8_t> data;   // fragment seq at seq * frag_size
+        std::vector<uint8_t> tail;   // last fragment, while frag_size is unknown
+        uint64_t received[4] = {0, 0, 0, 0};
+        uint16_t packet_id = 0;
+        uint16_t count = 0;
+        uint16_t frag_size = 0;      // payload of a non-last fragment, 0 = unknown
+        uint16_t last_len = 0;
         uint8_t last_seq = 0;
-        bool has_first = false;
         bool has_last = false;
+        bool tail_pending = false;
+        bool in_use = false;
+        uint32_t expiry_tick = 0;
+        int prev = -1;               // timer wheel bucket list
+        int next = -1;
     };
     
-    void cleanup_stale() {
-        auto now = std::chrono::steady_clock::now();
-        for (auto it = pending_.begin(); it != pending_.end();) {
-            auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - it->second.first_seen).count();
-            if (age > Frag::REASSEMBLY_TIMEOUT_MS) {
-                it = pending_.erase(it);
-            } else {
-                ++it;
+    static uint32_t now_tick() {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count() / TICK_MS);
+    }
+    
+    static int clz64(uint64_t v) {
+        int n = 0;
+        while (!(v & (uint64_t(1) << 63))) {
+            v <<= 1;
+            n++;
+        }
+        return n;
+    }
+    
+    static bool has_bit(const Slot& slot, int seq) {
+        return slot.received[seq >> 6] & (uint64_t(1) << (seq & 63));
+    }
+    
+    static bool any_bit_above(const Slot& slot, int seq) {
+        int w = seq >> 6;
+        int b = seq & 63;
+        if (b < 63 && (slot.received[w] & (~uint64_t(0) << (b + 1)))) return true;
+        for (int i = w + 1; i < 4; i++) {
+            if (slot.received[i]) return true;
+        }
+        return false;
+    }
+    
+    static void set_bit(Slot& slot, int seq) {
+        slot.received[seq >> 6] |= uint64_t(1) << (seq & 63);
+    }
+    
+    static bool place(Slot& slot, size_t offset, const uint8_t* src, size_t len) {
+        if (offset + len > Frag::MAX_PACKET_BYTES) return false;
+        if (slot.data.size() < offset + len) slot.data.resize(offset + len);
+        if (len) std::memcpy(slot.data.data() + offset, src, len);
+        return true;
+    }
+    
+    int alloc_slot(uint16_t packet_id) {
+        if (free_.empty()) evict_oldest();
+        int s = free_.back();
+        free_.pop_back();
+        Slot& slot = slots_[s];
+        slot.packet_id = packet_id;
+        slot.in_use = true;
+        index_[packet_id] = static_cast<int16_t>(s);
+        return s;
+    }
+    
+    void release(int s) {
+        Slot& slot = slots_[s];
+        unlink(s);
+        index_[slot.packet_id] = -1;
+        std::fill(std::begin(slot.received), std::end(slot.received), 0);
+        slot.count = 0;
+        slot.frag_size = 0;
+        slot.last_len = 0;
+        slot.last_seq = 0;
+        slot.has_last = false;
+        slot.tail_pending = false;
+        slot.in_use = false;
+        free_.push_back(s);
+    }
+    
+    void unlink(int s) {
+        Slot& slot = slots_[s];
+        if (slot.prev >= 0) {
+            slots_[slot.prev].next = slot.next;
+        } else if (buckets_[slot.expiry_tick % WHEEL_SIZE] == s) {
+            buckets_[slot.expiry_tick % WHEEL_SIZE] = slot.next;
+        }
+        if (slot.next >= 0) slots_[slot.next].prev = slot.prev;
+        slot.prev = slot.next = -1;
+    }
+    
+    void schedule(int s, uint32_t expiry_tick) {
+        unlink(s);
+        Slot& slot = slots_[s];
+        slot.expiry_tick = expiry_tick;
+        int& head = buckets_[expiry_tick % WHEEL_SIZE];
+        slot.next = head;
+        if (head >= 0) slots_[head].prev = s;
+        head = s;
+    }
+    
+    void advance_wheel(uint32_t now) {
+        // After a long quiet spell one pass over the wheel is enough
+        if (now - wheel_tick_ > WHEEL_SIZE) wheel_tick_ = now - WHEEL_SIZE;
+        while (wheel_tick_ != now) {
+            wheel_tick_++;
+            int s = buckets_[wheel_tick_ % WHEEL_SIZE];
+            while (s >= 0) {
+                int next = slots_[s].next;
+                if (static_cast<int32_t>(slots_[s].expiry_tick - now) <= 0) release(s);
+                s = next;
             }
         }
+    }
+    
+    // All slots busy: the one closest to expiry goes
+    void evict_oldest() {
+        for (uint32_t t = 1; t <= WHEEL_SIZE; t++) {
+            int s = buckets_[(wheel_tick_ + t) % WHEEL_SIZE];
+            if (s >= 0) {
+                release(s);
+                return;
+            }
+        }
+    }
+    
+    std::vector<int16_t> index_;     // packet id -> slot, -1 if none
+    std::vector<Slot> slots_;
+    std::vector<int> free_;
+    std::array<int, WHEEL_SIZE> buckets_;
+    uint32_t wheel_tick_;
+    mutable std::mutex mutex_;
+};
+
+// Selective-repeat ARQ between TNCs. Fragments of an ARQ packet carry 
+// Frag::FLAG_ARQ, the last one of each window also FLAG_POLL. The receiver
+// answers a poll (or completion) with a status extension frame listing the
+// fragments it is missing, and only those are sent again.
+namespace Arq {
+    constexpr uint8_t STATUS_COMPLETE   = 0x01;  // packet delivered
+    constexpr uint8_t STATUS_LAST_KNOWN = 0x02;  // count runs to the last fragment
+    
+    constexpr size_t STATUS_SIZE = 10;           // without the bitmap
+    constexpr size_t MAX_TRANSFERS = 16;
+    constexpr size_t MIN_WINDOW = 4;
+    constexpr size_t MAX_WINDOW = 32;
+    constexpr float WINDOW_SECONDS = 15.0f;      // airtime per window with auto sizing
+    
+    // Status body: [to:6] [packet id:2] [flags:1] [count:1] [missing bitmap]
+    struct Status {
+        int64_t to = 0;          // encoded call sign of the sending station
+        uint16_t packet_id = 0;
+        uint8_t flags = 0;
+        uint8_t count = 0;
+        std::vector<uint8_t> missing;
+    };
+    
+    inline std::vector<uint8_t> encode_status(uint8_t caps, const Status& s) {
+        auto frame = Ext::header(caps, Ext::TYPE_ARQ_STATUS);
+        Ext::put_call(frame, s.to);
+        frame.push_back((s.packet_id >> 8) & 0xFF);
+        frame.push_back(s.packet_id & 0xFF);
+        frame.push_back(s.flags);
+        frame.push_back(s.count);
+        frame.insert(frame.end(), s.missing.begin(), s.missing.end());
+        return frame;
+    }
+    
+    inline bool decode_status(const uint8_t* body, size_t len, Status& out) {
+        if (len < STATUS_SIZE) return false;
+        out.to = Ext::get_call(body);
+        out.packet_id = (body[6] << 8) | body[7];
+        out.flags = body[8];
+        out.count = body[9];
+        size_t bitmap_len = (out.count + 7) / 8;
+        if (len < STATUS_SIZE + bitmap_len) return false;
+        out.missing.assign(body + STATUS_SIZE, body + STATUS_SIZE + bitmap_len);
+        return true;
+    }
+    
+    inline bool is_missing(const Status& s, size_t seq) {
+        if (seq >= s.count) return !(s.flags & STATUS_LAST_KNOWN);
+        return s.missing[seq / 8] & (1 << (seq % 8));
+    }
+    
+    // Fragments per window: about WINDOW_SECONDS of airtime
+    inline size_t window_for(float frame_seconds) {
+        if (frame_seconds <= 0) return MIN_WINDOW;
+        size_t w = static_cast<size_t>(WINDOW_SECONDS / frame_seconds);
+        return std::max(MIN_WINDOW, std::min(MAX_WINDOW, w));
+    }
+}
+
+// Sending side of the ARQ: keeps the fragments of each packet until the
+// receiver has confirmed all of them.
+class ArqSender {
+public:
+    // What to send next for a packet: fragments reported missing go ahead
+    // of everything, new ones queue behind the rest of the packet's flow
+    struct Window {
+        std::vector<std::vector<uint8_t>> retransmit;
+        std::vector<std::vector<uint8_t>> fresh;
+        TxFlow flow;
+    };
+    
+    void configure(size_t window, int max_retries, int stall_ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_ = std::max<size_t>(1, window);
+        max_retries_ = max_retries;
+        stall_ms_ = stall_ms;
+    }
+    
+    // Takes over a fragmented packet queued for flow and fills out with the
+    // first window. Returns false if too many packets are in flight already.
+    bool start(const std::vector<std::vector<uint8_t>>& fragments, const TxFlow& flow,
+               std::vector<std::vector<uint8_t>>& out) {
+        if (fragments.empty() || fragments[0].size() < Frag::HEADER_SIZE) return false;
+        uint16_t packet_id = (fragments[0][1] << 8) | fragments[0][2];
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (transfers_.size() >= Arq::MAX_TRANSFERS) return false;
+        
+        auto& t = transfers_[packet_id];
+        t = Transfer();
+        t.fragments = fragments;
+        for (auto& frag : t.fragments) frag[4] |= Frag::FLAG_ARQ;
+        t.acked.assign(fragments.size(), false);
+        t.flow = flow;
+        t.last_activity = std::chrono::steady_clock::now();
+        out = next_window(t).fresh;
+        return true;
+    }
+    
+    // Forgets a packet whose first window never made it into the TX queue
+    void abort(uint16_t packet_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        transfers_.erase(packet_id);
+    }
+    
+    // Called as a fragment goes on air. A poll arms the status timer, 
+    // timeout_ms covers our own frame plus the receiver's turnaround.
+    void on_sending(const std::vector<uint8_t>& data, int timeout_ms) {
+        if (data.size() < Frag::HEADER_SIZE || data[0] != Frag::MAGIC) return;
+        if (!(data[4] & Frag::FLAG_POLL)) return;
+        uint16_t packet_id = (data[1] << 8) | data[2];
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = transfers_.find(packet_id);
+        if (it == transfers_.end()) return;
+        auto now = std::chrono::steady_clock::now();
+        it->second.polling = true;
+        it->second.deadline = now + std::chrono::milliseconds(timeout_ms);
+        it->second.last_activity = now;
+    }
+    
+    // Status from the receiver. Returns the fragments to send next; done is
+    // set once the packet has been delivered.
+    Window on_status(const Arq::Status& s, bool& done) {
+        done = false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = transfers_.find(s.packet_id);
+        if (it == transfers_.end()) return {};
+        Transfer& t = it->second;
+        
+        if (s.flags & Arq::STATUS_COMPLETE) {
+            transfers_.erase(it);
+            done = true;
+            return {};
+        }
         
-        while (pending_.size() > Frag::MAX_PENDING_PACKETS) {
-            auto oldest = pending_.begin();
-            for (auto it = pending_.begin(); it != pending_.end(); ++it) {
-                if (it->second.first_seen < oldest->second.first_seen) {
-                    oldest = it;
+        // Everything sent and not reported missing has arrived
+        for (size_t i = 0; i < t.next; i++) {
+            if (!Arq::is_missing(s, i)) t.acked[i] = true;
+        }
+        if (t.next == t.fragments.size() &&
+            std::all_of(t.acked.begin(), t.acked.end(), [](bool a) { return a; })) {
+            transfers_.erase(it);
+            done = true;
+            return {};
+        }
+        t.retries = 0;
+        t.polling = false;
+        t.last_activity = std::chrono::steady_clock::now();
+        return next_window(t);
+    }
+    
+    // Polls that went unanswered are repeated with the last outstanding
+    // fragment; after max_retries, or if a packet stalls in the TX queue, 
+    // it is given up and its id reported in failed.
+    std::vector<std::vector<uint8_t>> check_timeouts(std::vector<uint16_t>& failed) {
+        std::vector<std::vector<uint8_t>> out;
+        auto now = std::chrono::steady_clock::now();
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = transfers_.begin(); it != transfers_.end();) {
+            Transfer& t = it->second;
+            bool stalled = !t.polling && now - t.last_activity > std::chrono::milliseconds(stall_ms_);
+            if (stalled || (t.polling && now >= t.deadline && ++t.retries > max_retries_)) {
+                failed.push_back(it->first);
+                it = transfers_.erase(it);
+                continue;
+            }
+            if (t.polling && now >= t.deadline) {
+                t.polling = false;
+                t.last_activity = now;
+                for (size_t i = t.next; i-- > 0;) {
+                    if (!t.acked[i]) {
+                        out.push_back(t.fragments[i]);
+                        out.back()[4] |= Frag::FLAG_POLL;
+                        break;
+                    }
                 }
+                retransmitted_ += out.empty() ? 0 : 1;
+            }
+            ++it;
+        }
+        return out;
+    }
+    
+    size_t active() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return transfers_.size();
+    }
+    
+    uint64_t retransmitted() const { return retransmitted_; }
+    
+private:
+    struct Transfer {
+        std::vector<std::vector<uint8_t>> fragments;   // FLAG_ARQ set, no FLAG_POLL
+        std::vector<bool> acked;
+        TxFlow flow;              // where new fragments are queued
+        size_t next = 0;          // first fragment not sent yet
+        int retries = 0;
+        bool polling = false;     // poll on air, waiting for status
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point last_activity;
+    };
+    
+    // Missing fragments first, then new ones, up to a window; the last one
+    // polls for status
+    Window next_window(Transfer& t) {
+        Window w;
+        w.flow = t.flow;
+        for (size_t i = 0; i < t.next && w.retransmit.size() < window_; i++) {
+            if (!t.acked[i]) {
+                w.retransmit.push_back(t.fragments[i]);
+                retransmitted_++;
             }
-            pending_.erase(oldest);
         }
+        while (t.next < t.fragments.size() && w.retransmit.size() + w.fresh.size() < window_) {
+            w.fresh.push_back(t.fragments[t.next++]);
+        }
+        // New fragments go out after the retransmissions, so the last new
+        // one closes the window
+        auto& last = w.fresh.empty() ? w.retransmit : w.fresh;
+        if (!last.empty()) last.back()[4] |= Frag::FLAG_POLL;
+        return w;
     }
     
-    std::map<uint16_t, PendingPacket> pending_;
+    std::map<uint16_t, Transfer> transfers_;
+    size_t window_ = Arq::MIN_WINDOW;
+    int max_retries_ = 5;
+    int stall_ms_ = Frag::REASSEMBLY_TIMEOUT_MS;
+    std::atomic<uint64_t> retransmitted_{0};
     mutable std::mutex mutex_;
 };
+
+// Header compression for aggregate entries. The repetitive part of a 
+// packet's header (the AX.25 address field, or a Reticulum destination
+// hash) becomes a context shared with the peer TNCs:
+//   install: [INSTALL] [epoch:2] [cid] [gen] [offset] [len] [packet unchanged]
+//   use:     [USE] [epoch:2] [cid] [gen] [packet without the field]
+// Receivers keep contexts per sender. The epoch is drawn at random when
+// the sender starts; a new epoch from a station discards everything
+// installed by its previous run, so a restarted sender can't hit a stale
+// context with the same cid and gen. A use that doesn't match what the
+// receiver has (missed install, sender restart) is dropped and answered
+// with a TYPE_HC_NACK [to:6] [cid] [gen], after which the sender installs
+// again; installs are also repeated periodically.
+namespace HdrComp {
+    constexpr uint8_t OP_INSTALL = 0x01;
+    constexpr uint8_t OP_USE     = 0x02;
+    
+    constexpr size_t INSTALL_SIZE = 7;
+    constexpr size_t USE_SIZE = 5;
+    constexpr size_t CID_OFFSET = 3;   // cid, then gen
+    constexpr size_t NACK_SIZE = Ext::CALL_SIZE + 2;
+    constexpr size_t MAX_CONTEXTS = 256;
+    constexpr int REFRESH_USES = 32;
+    constexpr int REFRESH_MS = 2 * 60 * 1000;
+    constexpr int NACK_HOLDOFF_MS = 10000;
+    
+    inline bool ax25_address_char(uint8_t b) {
+        if (b & 1) return false;
+        char c = b >> 1;
+        return c == ' ' || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+    
+    // Reticulum flags and hops bytes: no IFAC (it would move the hashes),
+    // HEADER_2 exactly when the propagation type is transport, as Transport
+    // writes them, and at most PATHFINDER_M hops
+    inline bool reticulum_header(const std::vector<uint8_t>& p) {
+        if (p.size() < 2 || (p[0] & 0x80)) return false;
+        bool header_2 = p[0] & 0x40;
+        bool transport = p[0] & 0x10;
+        return header_2 == transport && p[1] <= 128;
+    }
+    
+    // Finds the header field worth a context: the AX.25 address field (2 to
+    // 10 addresses, the last with the extension bit set), else the Reticulum
+    // destination hash behind plausible flags and hops bytes (two hashes
+    // for HEADER_2). Misdetection only costs compression, not data.
+    inline bool find_field(const std::vector<uint8_t>& p, size_t& offset, size_t& len) {
+        for (size_t end = 6; end < p.size() && end < 70; end += 7) {
+            bool call_ok = true;
+            for (size_t i = end - 6; i < end; i++) call_ok &= ax25_address_char(p[i]);
+            if (!call_ok) break;
+            if (p[end] & 1) {
+                if (end + 1 < 14) break;
+                offset = 0;
+                len = end + 1;
+                return end + 1 < p.size();
+            }
+        }
+        
+        if (!reticulum_header(p)) return false;
+        size_t hash_len = (p[0] & 0x40) ? 32 : 16;
+        if (p.size() > 2 + hash_len) {
+            offset = 2;
+            len = hash_len;
+            return true;
+        }
+        return false;
+    }
+    
+    inline std::vector<uint8_t> encode_nack(uint8_t caps, int64_t to, uint8_t cid, uint8_t gen) {
+        auto frame = Ext::header(caps, Ext::TYPE_HC_NACK);
+        Ext::put_call(frame, to);
+        frame.push_back(cid);
+        frame.push_back(gen);
+        return frame;
+    }
+}
+
+// Sending side: one context table for everything we transmit
+class HeaderCompressor {
+public:
+    HeaderCompressor() : epoch_(static_cast<uint16_t>(std::random_device{}())) {}
+    
+    // Rewrites payload as an install or use; false leaves it untouched. A 
+    // field is only installed once it has been seen twice.
+    bool compress(std::vector<uint8_t>& payload) {
+        size_t offset, len;
+        if (!HdrComp::find_field(payload, offset, len)) return false;
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto key = std::make_pair(static_cast<uint8_t>(offset),
+                                  std::vector<uint8_t>(payload.begin() + offset, payload.begin() + offset + len));
+        
+        auto it = by_field_.find(key);
+        uint8_t cid;
+        if (it == by_field_.end()) {
+            cid = allocate();
+            Context& c = contexts_[cid];
+            c.key = key;
+            c.in_use = true;
+            c.gen++;
+            c.installed = false;
+            c.last_used = now;
+            by_field_[key] = cid;
+            return false;
+        }
+        cid = it->second;
+        
+        Context& c = contexts_[cid];
+        c.last_used = now;
+        bool refresh = !c.installed || ++c.uses >= HdrComp::REFRESH_USES ||
+                       now - c.installed_at > std::chrono::milliseconds(HdrComp::REFRESH_MS);
+        
+        std::vector<uint8_t> out;
+        if (refresh) {
+            out.reserve(HdrComp::INSTALL_SIZE + payload.size());
+            out = {HdrComp::OP_INSTALL, static_cast<uint8_t>(epoch_ >> 8), static_cast<uint8_t>(epoch_ & 0xFF),
+                   cid, c.gen, static_cast<uint8_t>(offset), static_cast<uint8_t>(len)};
+            out.insert(out.end(), payload.begin(), payload.end());
+            c.installed = true;
+            c.installed_at = now;
+            c.uses = 0;
+        } else {
+            out.reserve(HdrComp::USE_SIZE + payload.size() - len);
+            out = {HdrComp::OP_USE, static_cast<uint8_t>(epoch_ >> 8), static_cast<uint8_t>(epoch_ & 0xFF),
+                   cid, c.gen};
+            out.insert(out.end(), payload.begin(), payload.begin() + offset);
+            out.insert(out.end(), payload.begin() + offset + len, payload.end());
+            saved_ += len - HdrComp::USE_SIZE;
+        }
+        payload = std::move(out);
+        return true;
+    }
+    
+    // A receiver lacks this context, install it again on next use
+    void nack(uint8_t cid, uint8_t gen) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (contexts_[cid].in_use && contexts_[cid].gen == gen) {
+            contexts_[cid].installed = false;
+        }
+    }
+    
+    uint64_t bytes_saved() const { return saved_; }
+    
+private:
+    using Key = std::pair<uint8_t, std::vector<uint8_t>>;
+    
+    struct Context {
+        Key key;
+        uint8_t gen = 0;
+        bool in_use = false;
+        bool installed = false;
+        int uses = 0;
+        std::chrono::steady_clock::time_point installed_at;
+        std::chrono::steady_clock::time_point last_used;
+    };
+    
+    // A free id, or the least recently used one
+    uint8_t allocate() {
+        size_t lru = 0;
+        for (size_t i = 0; i < HdrComp::MAX_CONTEXTS; i++) {
+            if (!contexts_[i].in_use) return static_cast<uint8_t>(i);
+            if (contexts_[i].last_used < contexts_[lru].last_used) lru = i;
+        }
+        by_field_.erase(contexts_[lru].key);
+        return static_cast<uint8_t>(lru);
+    }
+    
+    const uint16_t epoch_;
+    std::array<Context, HdrComp::MAX_CONTEXTS> contexts_;
+    std::map<Key, uint8_t> by_field_;
+    std::atomic<uint64_t> saved_{0};
+    std::mutex mutex_;
+};
+
+// Receiving side: contexts per sending station
+class HeaderDecompressor {
+public:
+    // Rebuilds the packet in place. On an unknown context returns false and
+    // sets nack, the packet can't be recovered.
+    bool decompress(const std::string& call, std::vector<uint8_t>& payload, bool& nack) {
+        nack = false;
+        if (payload.size() < HdrComp::USE_SIZE) return false;
+        uint8_t op = payload[0];
+        uint16_t epoch = (payload[1] << 8) | payload[2];
+        uint8_t cid = payload[3], gen = payload[4];
+        if (op != HdrComp::OP_INSTALL && op != HdrComp::OP_USE) return false;
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& peer = peers_[call];
+        if (!peer.has_epoch || peer.epoch != epoch) {
+            // The sender restarted, nothing it installed before is valid
+            peer.contexts.fill(Context());
+            peer.epoch = epoch;
+            peer.has_epoch = true;
+        }
+        auto& table = peer.contexts;
+        
+        if (op == HdrComp::OP_INSTALL) {
+            if (payload.size() < HdrComp::INSTALL_SIZE) return false;
+            size_t offset = payload[5], len = payload[6];
+            if (HdrComp::INSTALL_SIZE + offset + len > payload.size()) return false;
+            Context& c = table[cid];
+            c.gen = gen;
+            c.valid = true;
+            c.offset = offset;
+            const uint8_t* field = payload.data() + HdrComp::INSTALL_SIZE + offset;
+            c.field.assign(field, field + len);
+            payload.erase(payload.begin(), payload.begin() + HdrComp::INSTALL_SIZE);
+            return true;
+        }
+        
+        Context& c = table[cid];
+        if (!c.valid || c.gen != gen || payload.size() < HdrComp::USE_SIZE + c.offset) {
+            // One NACK per context while the sender reacts
+            auto now = std::chrono::steady_clock::now();
+            if (now - c.nacked_at > std::chrono::milliseconds(HdrComp::NACK_HOLDOFF_MS)) {
+                c.nacked_at = now;
+                nack = true;
+            }
+            return false;
+        }
+        std::vector<uint8_t> out;
+        out.reserve(payload.size() - HdrComp::USE_SIZE + c.field.size());
+        out.insert(out.end(), payload.begin() + HdrComp::USE_SIZE, payload.begin() + HdrComp::USE_SIZE + c.offset);
+        out.insert(out.end(), c.field.begin(), c.field.end());
+        out.insert(out.end(), payload.begin() + HdrComp::USE_SIZE + c.offset, payload.end());
+        payload = std::move(out);
+        return true;
+    }
+    
+private:
+    struct Context {
+        bool valid = false;
+        uint8_t gen = 0;
+        size_t offset = 0;
+        std::vector<uint8_t> field;
+        std::chrono::steady_clock::time_point nacked_at;
+    };
+    
+    struct Peer {
+        uint16_t epoch = 0;
+        bool has_epoch = false;
+        std::array<Context, HdrComp::MAX_CONTEXTS> contexts;
+    };
+    
+    std::map<std::string, Peer> peers_;
+    std::mutex mutex_;
+};
@@ -0,0 +1,145 @@
+#ifndef LIBMODEM73_H
+#define LIBMODEM73_H
+
+/*
+ * libmodem73 - the modem73 TNC linked in-process.
+ *
+ * The same modem, fragmentation, ARQ, compression and CSMA as the KISS
+ * server, without the TCP hop: frames are submitted and received through
+ * function calls. Build with "make lib" (libmodem73.a, libmodem73.so).
+ *
+ *   m73_config cfg;
+ *   m73_config_init(&cfg);
+ *   cfg.callsign = "N0CALL";
+ *   m73_modem* m = m73_open(&cfg);
+ *   m73_submit(m, data, len, on_sent, ctx);
+ *   n = m73_receive(m, buf, sizeof(buf), &info, 1000);
+ *   m73_close(m);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#  ifdef MODEM73_LIB_MODE
+#    define M73_API __declspec(dllexport)
+#  else
+#    define M73_API
+#  endif
+#else
+#  define M73_API __attribute__((visibility("default")))
+#endif
+
+#define M73_OK            0
+#define M73_ERR_ARG      -1   /* bad argument or wrong mode */
+#define M73_ERR_BUFFER   -2   /* frame larger than the buffer, still queued */
+#define M73_ERR_FULL     -3   /* TX queue full or duplicate, frame dropped */
+#define M73_ERR_DROPPED  -4   /* accepted, then dropped before it was sent */
+
+#define M73_CALLSIGN_MAX 16
+
+typedef struct m73_modem m73_modem;
+
+typedef struct m73_config {
+    const char* callsign;        /* "N0CALL" */
+    const char* modulation;      /* BPSK QPSK 8PSK QAM16 QAM64 QAM256, "QPSK" */
+    const char* code_rate;       /* 1/2 2/3 3/4 5/6 1/4, "1/2" */
+    int short_frame;             /* 0 */
+    int center_freq;             /* Hz, 1500 */
+    int sample_rate;             /* 48000 */
+
+    /* Audio: a device pair, or samples moved by the caller through
+       m73_process_audio() when external_audio is set */
+    const char* input_device;    /* "default" */
+    const char* output_device;   /* "default" */
+    int external_audio;          /* 0 */
+
+    /* PTT: "none", "rigctl", "vox", "com" */
+    const char* ptt;             /* "none" */
+    const char* rigctl_host;     /* "localhost" */
+    int rigctl_port;             /* 4532 */
+    const char* com_port;        /* "COM3" */
+
+    int csma;                    /* 1 */
+    int fragmentation;           /* 0 */
+    int verbose;                 /* 0 */
+} m73_config;
+
+typedef struct m73_rx_info {
+    size_t length;               /* frame length in bytes */
+    float snr_db;
+    char callsign[M73_CALLSIGN_MAX];   /* sending station, NUL terminated */
+    int reassembled;             /* built from several OFDM frames */
+    uint64_t time_ms;            /* when the preamble reached the sound card,
+                                    ms since the Unix epoch */
+    int overrun;                 /* capture samples were lost inside the frame,
+                                    time_ms and snr_db are off */
+} m73_rx_info;
+
+/* Audio overruns and underruns since m73_open() */
+typedef struct m73_stats {
+    uint64_t capture_overruns;   /* capture callbacks cut short, ring full */
+    uint64_t capture_lost;       /* samples lost to them */
+    uint64_t playback_underruns; /* transmissions the playback ring ran dry in */
+    uint64_t playback_padded;    /* silence padded in for them */
+    uint64_t rx_overrun_frames;  /* frames decoded across lost samples */
+    uint64_t tx_underrun_frames; /* frames that went out with a gap */
+} m73_stats;
+
+/* Called exactly once for every frame a submit call accepted, on one of
+   the modem's threads: status M73_OK once the frame has been sent and PTT
+   has been released (for ARQ packets: once the peer confirmed it), or
+   M73_ERR_DROPPED if it never will be (TTL expired, pushed out of a full
+   queue, ARQ gave up; from m73_close() for frames still queued). */
+typedef void (*m73_tx_done_fn)(void* user, int status);
+
+/* Log lines that the TNC prints or shows in its UI */
+typedef void (*m73_log_fn)(void* user, const char* line);
+
+M73_API void m73_config_init(m73_config* cfg);
+
+/* NULL on failure, see m73_last_error() */
+M73_API m73_modem* m73_open(const m73_config* cfg);
+M73_API void m73_close(m73_modem* m);
+
+/* Error of the last failed call on this thread */
+M73_API const char* m73_last_error(void);
+
+/* Process wide, call before m73_open() */
+M73_API void m73_set_log(m73_log_fn fn, void* user);
+
+/* Queues a frame; done may be NULL. The data is copied. M73_ERR_FULL if
+   the frame was dropped at once; done is then never called. */
+M73_API int m73_submit(m73_modem* m, const uint8_t* data, size_t len,
+                       m73_tx_done_fn done, void* user);
+
+/* Sends one OFDM frame so that its first sample leaves the sound card at
+   at_ms (ms since the Unix epoch, the clock of m73_rx_info.time_ms), keying
+   up ahead of it. Bypasses the TX queue and CSMA. M73_ERR_ARG if the frame
+   needs fragmenting, M73_ERR_FULL if 32 frames are scheduled already. */
+M73_API int m73_submit_at(m73_modem* m, const uint8_t* data, size_t len, uint64_t at_ms,
+                          m73_tx_done_fn done, void* user);
+
+/* Fills stats, M73_ERR_ARG without a modem or stats */
+M73_API int m73_get_stats(m73_modem* m, m73_stats* stats);
+
+/* Copies the next decoded frame into buf and returns its length, 0 when
+   timeout_ms passed without one (-1 waits forever). info may be NULL. */
+M73_API int m73_receive(m73_modem* m, uint8_t* buf, size_t cap,
+                        m73_rx_info* info, int timeout_ms);
+
+/* external_audio only: hands frames captured from the radio to the
+   demodulator (in may be NULL) and fills out with frames to play to the
+   radio, silence when idle (out may be NULL). Call at the sample rate from
+   one thread, like a sound card callback. Returns frames or M73_ERR_ARG. */
+M73_API int m73_process_audio(m73_modem* m, const float* in, float* out, int frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBMODEM73_H */
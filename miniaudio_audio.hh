@@ -14,6 +14,253 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <array>
+
+// Sample ring between a device callback and one TNC thread: one producer,
+// one consumer. The capacity is a power of two, so the free running indices
+// are masked instead of taken modulo, and a block moves with at most two
+// memcpy calls. Head and tail sit on separate cache lines.
+//
+// A thread that finds the ring empty (or full) sleeps on a condition
+// variable; the other side only takes the mutex to wake it when someone is
+// actually waiting, so the audio callback doesn't lock in the common case.
+class SampleRing {
+public:
+    static constexpr size_t CACHE_LINE = 64;
+    
+    // capacity is rounded up to a power of two
+    void reset(size_t capacity) {
+        size_t cap = 1024;
+        while (cap < capacity && cap < (size_t(1) << 26)) cap <<= 1;
+        buffer_.assign(cap, 0.0f);
+        mask_ = cap - 1;
+        clear();
+    }
+    
+    // Only while neither side is running
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+    
+    size_t capacity() const { return mask_ + 1; }
+    
+    // Consumer side
+    size_t available() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+    
+    // Producer side
+    size_t space() const {
+        return capacity() - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+    }
+    
+    // Both return the number of samples moved
+    size_t write(const float* src, size_t n) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        n = std::min(n, capacity() - (head - tail_.load(std::memory_order_acquire)));
+        if (n == 0) return 0;
+        size_t off = head & mask_;
+        size_t first = std::min(n, capacity() - off);
+        std::memcpy(buffer_.data() + off, src, first * sizeof(float));
+        std::memcpy(buffer_.data(), src + first, (n - first) * sizeof(float));
+        head_.store(head + n, std::memory_order_release);
+        wake();
+        return n;
+    }
+    
+    size_t read(float* dst, size_t n) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        n = std::min(n, head_.load(std::memory_order_acquire) - tail);
+        if (n == 0) return 0;
+        size_t off = tail & mask_;
+        size_t first = std::min(n, capacity() - off);
+        std::memcpy(dst, buffer_.data() + off, first * sizeof(float));
+        std::memcpy(dst + first, buffer_.data(), (n - first) * sizeof(float));
+        tail_.store(tail + n, std::memory_order_release);
+        wake();
+        return n;
+    }
+    
+    // Block until at least one sample can be read (or written), false on
+    // timeout
+    template <class Clock, class Duration>
+    bool wait_readable(const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_until(deadline, [this] { return available() > 0; });
+    }
+    
+    template <class Clock, class Duration>
+    bool wait_writable(const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_until(deadline, [this] { return space() > 0; });
+    }
+    
+    // Samples written and read since clear(), the free running indices
+    size_t written() const { return head_.load(std::memory_order_acquire); }
+    size_t consumed() const { return tail_.load(std::memory_order_acquire); }
+    
+    // Block until the consumer has read up to position mark
+    template <class Clock, class Duration>
+    bool wait_consumed(size_t mark, const std::chrono::time_point<Clock, Duration>& deadline) {
+        return wait_until(deadline, [this, mark] { return consumed() >= mark; });
+    }
+    
+private:
+    template <class Clock, class Duration, class Pred>
+    bool wait_until(const std::chrono::time_point<Clock, Duration>& deadline, Pred ready) {
+        if (ready()) return true;
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ok = cv_.wait_until(lock, deadline, ready);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return ok;
+    }
+    
+    // Pairs with the seq_cst increment in wait_until(): either the waiter
+    // sees the new index, or we see the waiter
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        cv_.notify_all();
+    }
+    
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0};   // written by the producer
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0};   // written by the consumer
+    alignas(CACHE_LINE) std::atomic<int> waiters_{0};
+    std::vector<float> buffer_;
+    size_t mask_ = 0;
+    std::mutex wait_mutex_;
+    std::condition_variable cv_;
+};
+
+// Maps a device's running frame count to steady_clock. The callback
+// reports (frame, time) pairs; a point is kept every quarter second, up to
+// POINTS of them (about half a minute). The frame period is the least
+// squares slope over those, which measures the drift between the sound
+// card's crystal and the system clock, and the offset follows the lower
+// envelope of the last eight seconds, since scheduling jitter only ever
+// makes a report late.
+// One thread updates, any thread reads.
+class SampleClock {
+public:
+    static constexpr size_t POINTS = 128;
+    static constexpr size_t ENVELOPE_POINTS = 32;
+    
+    void reset(int sample_rate) {
+        sample_rate_ = std::max(sample_rate, 1);
+        count_ = 0;
+        next_ = 0;
+        publish(0, 0, 1e9 / sample_rate_, false);
+    }
+    
+    void update(uint64_t frame, int64_t ns) {
+        if (count_ > 0 && frame < last_frame_ + uint64_t(sample_rate_ / 4)) return;
+        last_frame_ = frame;
+        points_[next_] = {frame, ns};
+        next_ = (next_ + 1) % POINTS;
+        count_ = std::min(count_ + 1, POINTS);
+        
+        const double nominal = 1e9 / sample_rate_;
+        const Point& ref = points_[(next_ + POINTS - count_) % POINTS];
+        double slope = nominal;
+        if (count_ >= 8) {
+            double sf = 0, st = 0, sff = 0, sft = 0;
+            for (size_t i = 0; i < count_; i++) {
+                const Point& p = points_[i];
+                double f = double(p.frame - ref.frame);
+                double t = double(p.ns - ref.ns);
+                sf += f; st += t; sff += f * f; sft += f * t;
+            }
+            double den = count_ * sff - sf * sf;
+            if (den > 0) slope = (count_ * sft - sf * st) / den;
+            slope = std::max(nominal * 0.99, std::min(nominal * 1.01, slope));
+        }
+        
+        // Offset from the lower envelope of the most recent points, so a
+        // small slope error doesn't move the present
+        const Point& last = points_[(next_ + POINTS - 1) % POINTS];
+        double low = 0;
+        for (size_t k = 1; k <= std::min(count_, ENVELOPE_POINTS); k++) {
+            const Point& p = points_[(next_ + POINTS - k) % POINTS];
+            double r = double(p.ns - last.ns) - slope * (double(p.frame) - double(last.frame));
+            if (k == 1 || r < low) low = r;
+        }
+        publish(last.frame, last.ns + int64_t(low), slope, true);
+    }
+    
+    bool valid() const { return read().valid; }
+    
+    int64_t time_of(uint64_t frame) const {
+        Fit f = read();
+        return f.base_ns + int64_t((double(frame) - double(f.base_frame)) * f.ns_per_frame);
+    }
+    
+    uint64_t frame_at(int64_t ns) const {
+        Fit f = read();
+        double d = double(ns - f.base_ns) / f.ns_per_frame;
+        return uint64_t(std::max(0.0, double(f.base_frame) + d));
+    }
+    
+    // Measured frames per second of steady_clock time
+    double rate() const { return 1e9 / read().ns_per_frame; }
+    
+private:
+    struct Point {
+        uint64_t frame;
+        int64_t ns;
+    };
+    struct Fit {
+        uint64_t base_frame;
+        int64_t base_ns;
+        double ns_per_frame;
+        bool valid;
+    };
+    
+    // Sequence lock: odd while the writer is between the two stores
+    void publish(uint64_t frame, int64_t ns, double ns_per_frame, bool valid) {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        base_frame_.store(frame, std::memory_order_relaxed);
+        base_ns_.store(ns, std::memory_order_relaxed);
+        ns_per_frame_.store(ns_per_frame, std::memory_order_relaxed);
+        valid_.store(valid, std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+    
+    Fit read() const {
+        Fit f;
+        uint32_t before, after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            f.base_frame = base_frame_.load(std::memory_order_relaxed);
+            f.base_ns = base_ns_.load(std::memory_order_relaxed);
+            f.ns_per_frame = ns_per_frame_.load(std::memory_order_relaxed);
+            f.valid = valid_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return f;
+    }
+    
+    // Writer only
+    std::array<Point, POINTS> points_{};
+    size_t count_ = 0;
+    size_t next_ = 0;
+    uint64_t last_frame_ = 0;
+    int sample_rate_ = 48000;
+    
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint64_t> base_frame_{0};
+    std::atomic<int64_t> base_ns_{0};
+    std::atomic<double> ns_per_frame_{1e9 / 48000};
+    std::atomic<bool> valid_{false};
+};
 
 class MiniAudio {
 public:
@@ -91,10 +338,14 @@ public:
     
     MiniAudio(const std::string& capture_dev = "default", 
               const std::string& playback_dev = "default",
-              int sample_rate = 48000)
+              int sample_rate = 48000,
+              int buffer_ms = DEFAULT_BUFFER_MS)
         : capture_device_id_(capture_dev), playback_device_id_(playback_dev), sample_rate_(sample_rate) {
-        capture_buffer_.resize(RING_BUFFER_SIZE, 0.0f);
-        playback_buffer_.resize(RING_BUFFER_SIZE, 0.0f);
+        size_t frames = size_t(sample_rate) * std::max(buffer_ms, 20) / 1000;
+        capture_ring_.reset(frames);
+        playback_ring_.reset(frames);
+        capture_clock_.reset(sample_rate);
+        playback_clock_.reset(sample_rate);
     }
     
     ~MiniAudio() {
@@ -154,6 +405,12 @@ public:
             return false;
         }
         
+        // Everything queued in the device's periods plays before a frame
+        // handed over in the callback
+        playback_latency_ns_ = int64_t(playback_device_.playback.internalPeriodSizeInFrames) *
+                               playback_device_.playback.internalPeriods * 1000000000LL /
+                               std::max<ma_uint32>(playback_device_.playback.internalSampleRate, 1);
+        
         if (ma_device_start(&playback_device_) != MA_SUCCESS) {
             std::cerr << "Failed to start playback device" << std::endl;
             ma_device_uninit(&playback_device_);
@@ -161,7 +418,8 @@ public:
         }
         
         playback_open_ = true;
-        std::cerr << "Playback: " << playback_device_.playback.name << std::endl;
+        std::cerr << "Playback: " << playback_device_.playback.name
+                  << " (latency " << playback_latency_ns_ / 1000000 << " ms)" << std::endl;
         return true;
     }
     
@@ -199,6 +457,11 @@ public:
             return false;
         }
         
+        // A frame reaches the callback after the device's periods filled
+        capture_latency_ns_ = int64_t(capture_device_.capture.internalPeriodSizeInFrames) *
+                              capture_device_.capture.internalPeriods * 1000000000LL /
+                              std::max<ma_uint32>(capture_device_.capture.internalSampleRate, 1);
+        
         if (ma_device_start(&capture_device_) != MA_SUCCESS) {
             std::cerr << "Failed to start capture device" << std::endl;
             ma_device_uninit(&capture_device_);
@@ -210,51 +473,74 @@ public:
         return true;
     }
     
+    // No devices: the caller moves samples through process_stream(), as a
+    // sound card callback would (libmodem73 with caller-provided audio)
+    bool open_stream() {
+        close_capture();
+        close_playback();
+        external_ = true;
+        playback_latency_ns_ = 0;
+        capture_latency_ns_ = 0;
+        capture_open_ = true;
+        playback_open_ = true;
+        return true;
+    }
+    
+    // in: frames captured from the radio (may be null), out: frames to send
+    // to the radio, silence when nothing is queued (may be null)
+    int process_stream(const float* in, float* out, int frames) {
+        if (!external_ || frames < 0) return -1;
+        if (in) capture(in, frames);
+        if (out) render(out, frames);
+        return frames;
+    }
+    
+    bool is_stream() const { return external_; }
+    
     void close_playback() {
-        if (playback_open_) {
+        if (external_) {
+            playback_open_ = false;
+        } else if (playback_open_) {
             ma_device_uninit(&playback_device_);
             playback_open_ = false;
         }
-        playback_read_pos_ = 0;
-        playback_write_pos_ = 0;
+        playback_ring_.clear();
+        playback_frames_ = 0;
+        playback_offset_.store(0, std::memory_order_relaxed);
+        playback_streaming_.store(false, std::memory_order_relaxed);
+        playback_clock_.reset(sample_rate_);
     }
     
     void close_capture() {
-        if (capture_open_) {
+        if (external_) {
+            capture_open_ = false;
+        } else if (capture_open_) {
             ma_device_uninit(&capture_device_);
             capture_open_ = false;
         }
-        capture_read_pos_ = 0;
-        capture_write_pos_ = 0;
+        capture_ring_.clear();
+        capture_frames_ = 0;
+        capture_dropped_.store(0, std::memory_order_relaxed);
+        gap_count_.store(0, std::memory_order_relaxed);
+        consecutive_overruns_.store(0, std::memory_order_relaxed);
+        capture_clock_.reset(sample_rate_);
+        capture_generation_.fetch_add(1, std::memory_order_release);
     }
     
     int read(float* buffer, int frames) {
         if (!capture_open_) return -1;
         
         int frames_read = 0;
-        int timeout_ms = 1000;
-        auto start = std::chrono::steady_clock::now();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(IO_TIMEOUT_MS);
         
         while (frames_read < frames) {
-            size_t read_pos = capture_read_pos_.load();
-            size_t write_pos = capture_write_pos_.load();
-            size_t available = (write_pos - read_pos + RING_BUFFER_SIZE) % RING_BUFFER_SIZE;
-            
-            if (available > 0) {
-                int to_read = std::min((int)available, frames - frames_read);
-                for (int i = 0; i < to_read; i++) {
-                    buffer[frames_read + i] = capture_buffer_[(read_pos + i) % RING_BUFFER_SIZE];
-                }
-                capture_read_pos_ = (read_pos + to_read) % RING_BUFFER_SIZE;
-                frames_read += to_read;
-                consecutive_read_failures_ = 0; 
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > timeout_ms) {
-                    consecutive_read_failures_++;
-                    break;
-                }
+            size_t n = capture_ring_.read(buffer + frames_read, frames - frames_read);
+            if (n > 0) {
+                frames_read += static_cast<int>(n);
+                consecutive_read_failures_ = 0;
+            } else if (!capture_ring_.wait_readable(deadline)) {
+                consecutive_read_failures_++;
+                break;
             }
         }
         
@@ -265,45 +551,57 @@ public:
         if (!playback_open_) return -1;
         
         int frames_written = 0;
-        int timeout_ms = 1000;
-        auto start = std::chrono::steady_clock::now();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(IO_TIMEOUT_MS);
         
         while (frames_written < frames) {
-            size_t read_pos = playback_read_pos_.load();
-            size_t write_pos = playback_write_pos_.load();
-            size_t used = (write_pos - read_pos + RING_BUFFER_SIZE) % RING_BUFFER_SIZE;
-            size_t available = RING_BUFFER_SIZE - 1 - used;
-            
-            if (available > 0) {
-                int to_write = std::min((int)available, frames - frames_written);
-                for (int i = 0; i < to_write; i++) {
-                    playback_buffer_[(write_pos + i) % RING_BUFFER_SIZE] = buffer[frames_written + i];
-                }
-                playback_write_pos_ = (write_pos + to_write) % RING_BUFFER_SIZE;
-                frames_written += to_write;
-                consecutive_write_failures_ = 0;  
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > timeout_ms) {
-                    consecutive_write_failures_++;
-                    break;
-                }
+            size_t n = playback_ring_.write(buffer + frames_written, frames - frames_written);
+            if (n > 0) {
+                frames_written += static_cast<int>(n);
+                consecutive_write_failures_ = 0;
+                playback_streaming_.store(true, std::memory_order_release);
+            } else if (!playback_ring_.wait_writable(deadline)) {
+                consecutive_write_failures_++;
+                break;
             }
         }
         
         return frames_written;
     }
     
-    // check audio status
+    // check audio status; a capture ring that overflows callback after
+    // callback has a reader that stopped keeping up
     bool is_healthy() const {
         return capture_open_ && playback_open_ && 
                consecutive_read_failures_ < 3 && 
-               consecutive_write_failures_ < 3;
+               consecutive_write_failures_ < 3 &&
+               consecutive_overruns_.load(std::memory_order_relaxed) < 3;
+    }
+    
+    // Capture callbacks the full ring cut short, and the frames they lost
+    uint64_t capture_overruns() const { return capture_overruns_.load(std::memory_order_relaxed); }
+    uint64_t capture_lost() const { return capture_lost_.load(std::memory_order_relaxed); }
+    
+    // Times the playback ring ran dry while a transmission was still being
+    // written (between write() and wait_played()), and the silence padded in
+    uint64_t playback_underruns() const { return playback_underruns_.load(std::memory_order_relaxed); }
+    uint64_t playback_padded() const { return playback_padded_.load(std::memory_order_relaxed); }
+    
+    // True if capture frames were lost between two ring positions, so the
+    // stretch from..to isn't contiguous audio
+    bool capture_gap_between(size_t from, size_t to) const {
+        return dropped_before(to) != dropped_before(from);
+    }
+    
+    void reset_stats() {
+        capture_overruns_.store(0, std::memory_order_relaxed);
+        capture_lost_.store(0, std::memory_order_relaxed);
+        playback_underruns_.store(0, std::memory_order_relaxed);
+        playback_padded_.store(0, std::memory_order_relaxed);
     }
     
     // attempt to reconnect audio devices
     bool reconnect() {
+        if (external_) return true;
         close_capture();
         close_playback();
         
@@ -322,50 +620,95 @@ public:
         write(silence.data(), frames);
     }
     
-    void drain_playback() {
-        if (!playback_open_) return;
-        
-        int timeout_ms = 2000;
-        auto start = std::chrono::steady_clock::now();
-        
-        while (true) {
-            size_t read_pos = playback_read_pos_.load();
-            size_t write_pos = playback_write_pos_.load();
-            if (read_pos == write_pos) break;
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            auto now = std::chrono::steady_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() > timeout_ms) {
-                break;
+    // Capture ring position of the next frame read() returns
+    size_t capture_position() const { return capture_ring_.consumed(); }
+    
+    // Bumped whenever the capture side closes: positions start over at 0
+    // and the gap history is gone
+    uint32_t capture_generation() const { return capture_generation_.load(std::memory_order_acquire); }
+    
+    // When the frame at a capture ring position reached the sound card, on
+    // the sound card's clock mapped to steady_clock; now until the first
+    // callbacks have come in
+    std::chrono::steady_clock::time_point capture_time(size_t position) const {
+        if (!capture_clock_.valid()) return std::chrono::steady_clock::now();
+        uint64_t frame = position + dropped_before(position);
+        return to_time_point(capture_clock_.time_of(frame));
+    }
+    
+    // When the frame at a playback ring position leaves the sound card, for
+    // positions already written
+    std::chrono::steady_clock::time_point playback_time(size_t position) const {
+        if (!playback_clock_.valid()) return std::chrono::steady_clock::now();
+        return to_time_point(playback_clock_.time_of(position + playback_offset_.load(std::memory_order_acquire)));
+    }
+    
+    // Writes frames so that the first leaves the sound card at when,
+    // preceded by silence; false (and written straight away) if when can no
+    // longer be met. Exact to the frame while the ring has data queued, to
+    // within a device period when it has run dry.
+    bool write_at(const float* buffer, int frames, std::chrono::steady_clock::time_point when) {
+        if (!playback_open_) return false;
+        bool on_time = true;
+        if (playback_clock_.valid()) {
+            int64_t when_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+            uint64_t target = playback_clock_.frame_at(when_ns);
+            uint64_t next = playback_ring_.written() + playback_offset_.load(std::memory_order_acquire);
+            if (target >= next) {
+                write_silence(static_cast<int>(std::min<uint64_t>(target - next, uint64_t(sample_rate_) * 60)));
+            } else {
+                on_time = false;
             }
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return write(buffer, frames) == frames && on_time;
     }
     
-    float measure_level(int duration_ms = 100) {
-        if (!capture_open_) return -100.0f;
-        
-        int frames = (sample_rate_ * duration_ms) / 1000;
-        std::vector<float> buffer(frames);
-        
-        int total_read = read(buffer.data(), frames);
-        if (total_read <= 0) return -100.0f;
-        
-        float sum_sq = 0.0f;
-        for (int i = 0; i < total_read; i++) {
-            sum_sq += buffer[i] * buffer[i];
+    // Measured sample rates against steady_clock
+    double capture_rate() const { return capture_clock_.rate(); }
+    double playback_rate() const { return playback_clock_.rate(); }
+    
+    // Position after the last frame written so far, for wait_played()
+    size_t playback_mark() const { return playback_ring_.written(); }
+    
+    // Blocks until the device callback has taken every frame before mark
+    // and sets done to when the last of them leaves the sound card: the
+    // callback's time, plus the frame's place in the buffer it filled, plus
+    // the device latency. Exact while nothing is written after mark.
+    bool wait_played(size_t mark, std::chrono::steady_clock::time_point& done) {
+        done = std::chrono::steady_clock::now();
+        if (!playback_open_) return false;
+        // The stream ends here, running dry after it isn't an underrun
+        playback_streaming_.store(false, std::memory_order_release);
+        
+        auto timeout = std::chrono::milliseconds(IO_TIMEOUT_MS +
+            int64_t(playback_ring_.capacity()) * 1000 / std::max(sample_rate_, 1));
+        if (!playback_ring_.wait_consumed(mark, done + timeout)) {
+            done = std::chrono::steady_clock::now();
+            return false;
+        }
+        done = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(played_until_ns_.load(std::memory_order_relaxed))));
+        return true;
+    }
+    
+    // Returns once everything written so far has been played
+    void drain_playback() {
+        std::chrono::steady_clock::time_point done;
+        if (wait_played(playback_mark(), done)) {
+            std::this_thread::sleep_until(done);
         }
-        float rms = std::sqrt(sum_sq / total_read);
-        
-        if (rms < 1e-10f) return -100.0f;
-        return 20.0f * std::log10(rms);
     }
     
     int sample_rate() const { return sample_rate_; }
     
+    // Ring sizes in frames (power of two)
+    size_t capture_capacity() const { return capture_ring_.capacity(); }
+    size_t playback_capacity() const { return playback_ring_.capacity(); }
+    
+    static constexpr int DEFAULT_BUFFER_MS = 1000;
+    
 private:
-    static constexpr size_t RING_BUFFER_SIZE = 48000;
+    static constexpr int IO_TIMEOUT_MS = 1000;
     
     bool ensure_context() {
         if (context_initialized_) return true;
@@ -381,41 +724,105 @@ private:
     static void playback_callback(ma_device* device, void* output, const void* input, ma_uint32 frame_count) {
         (void)input;
         MiniAudio* self = static_cast<MiniAudio*>(device->pUserData);
-        float* out = static_cast<float*>(output);
-        
-        size_t read_pos = self->playback_read_pos_.load();
-        size_t write_pos = self->playback_write_pos_.load();
-        size_t available = (write_pos - read_pos + RING_BUFFER_SIZE) % RING_BUFFER_SIZE;
-        
-        ma_uint32 to_read = std::min((ma_uint32)available, frame_count);
-        
-        for (ma_uint32 i = 0; i < to_read; i++) {
-            out[i] = self->playback_buffer_[(read_pos + i) % RING_BUFFER_SIZE];
-        }
-        for (ma_uint32 i = to_read; i < frame_count; i++) {
-            out[i] = 0.0f;
-        }
-        
-        self->playback_read_pos_ = (read_pos + to_read) % RING_BUFFER_SIZE;
+        self->render(static_cast<float*>(output), frame_count);
     }
     
     static void capture_callback(ma_device* device, void* output, const void* input, ma_uint32 frame_count) {
         (void)output;
         MiniAudio* self = static_cast<MiniAudio*>(device->pUserData);
-        const float* in = static_cast<const float*>(input);
-        
-        size_t read_pos = self->capture_read_pos_.load();
-        size_t write_pos = self->capture_write_pos_.load();
-        size_t used = (write_pos - read_pos + RING_BUFFER_SIZE) % RING_BUFFER_SIZE;
-        size_t available = RING_BUFFER_SIZE - 1 - used;
-        
-        ma_uint32 to_write = std::min((ma_uint32)available, frame_count);
-        
-        for (ma_uint32 i = 0; i < to_write; i++) {
-            self->capture_buffer_[(write_pos + i) % RING_BUFFER_SIZE] = in[i];
+        self->capture(static_cast<const float*>(input), frame_count);
+    }
+    
+    static std::chrono::steady_clock::time_point to_time_point(int64_t ns) {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ns)));
+    }
+    
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // Playback ring -> output, padded with silence. Device frame
+    // playback_frames_ leaves the sound card one device latency from now.
+    void render(float* out, size_t frame_count) {
+        int64_t now = now_ns();
+        playback_clock_.update(playback_frames_, now + playback_latency_ns_);
+        
+        size_t n = std::min(playback_ring_.available(), frame_count);
+        if (n > 0) {
+            // When the last of these frames reaches the radio. Stored before
+            // the ring releases them, so wait_played() sees it.
+            played_until_ns_.store(now + playback_latency_ns_ + int64_t(n) * 1000000000LL / sample_rate_,
+                                   std::memory_order_relaxed);
+        }
+        size_t tail = playback_ring_.consumed();
+        n = playback_ring_.read(out, n);
+        std::fill(out + n, out + frame_count, 0.0f);
+        if (n < frame_count && playback_streaming_.exchange(false, std::memory_order_acq_rel)) {
+            // Counted once per dry spell, the next write() rearms
+            playback_underruns_.fetch_add(1, std::memory_order_relaxed);
+            playback_padded_.fetch_add(frame_count - n, std::memory_order_relaxed);
         }
         
-        self->capture_write_pos_ = (write_pos + to_write) % RING_BUFFER_SIZE;
+        // Ring position -> device frame. After running dry the next frame
+        // written goes out with the next callback.
+        uint64_t device = n < frame_count ? playback_frames_ + frame_count : playback_frames_;
+        size_t ring = n < frame_count ? tail + n : tail;
+        playback_offset_.store(device - ring, std::memory_order_release);
+        playback_frames_ += frame_count;
+    }
+    
+    // Input -> capture ring, dropping what doesn't fit. The newest frame
+    // left the radio one device latency ago.
+    void capture(const float* in, size_t frame_count) {
+        capture_clock_.update(capture_frames_ + frame_count - 1, now_ns() - capture_latency_ns_);
+        capture_frames_ += frame_count;
+        size_t n = capture_ring_.write(in, frame_count);
+        if (n < frame_count) {
+            capture_dropped_.fetch_add(frame_count - n, std::memory_order_relaxed);
+            capture_overruns_.fetch_add(1, std::memory_order_relaxed);
+            capture_lost_.fetch_add(frame_count - n, std::memory_order_relaxed);
+            record_gap(capture_ring_.written(), frame_count - n);
+            consecutive_overruns_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            consecutive_overruns_.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    // Callback only: the ring position after a lost stretch and how much
+    // was lost, behind a sequence lock for dropped_before()
+    void record_gap(size_t position, uint64_t lost) {
+        uint32_t seq = gap_seq_.load(std::memory_order_relaxed);
+        gap_seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        size_t count = gap_count_.load(std::memory_order_relaxed);
+        Gap& g = gaps_[count % GAP_HISTORY];
+        g.position.store(position, std::memory_order_relaxed);
+        g.lost.store(lost, std::memory_order_relaxed);
+        g.dropped.store(capture_dropped_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        gap_count_.store(count + 1, std::memory_order_relaxed);
+        gap_seq_.store(seq + 2, std::memory_order_release);
+    }
+    
+    // Device frames lost ahead of a ring position: only the gaps before it
+    // count, so a later overrun doesn't move earlier timestamps. Positions
+    // older than the gaps kept get the count from before the oldest.
+    uint64_t dropped_before(size_t position) const {
+        while (true) {
+            uint32_t seq = gap_seq_.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            size_t count = gap_count_.load(std::memory_order_relaxed);
+            uint64_t dropped = 0;
+            for (size_t k = 1; k <= std::min(count, GAP_HISTORY); k++) {
+                const Gap& g = gaps_[(count - k) % GAP_HISTORY];
+                dropped = g.dropped.load(std::memory_order_relaxed);
+                if (g.position.load(std::memory_order_relaxed) <= position) break;
+                dropped -= g.lost.load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (gap_seq_.load(std::memory_order_relaxed) == seq) return dropped;
+        }
     }
     
     std::string capture_device_id_;
@@ -431,13 +838,41 @@ private:
     ma_device_id stored_playback_id_;
     bool playback_open_ = false;
     bool capture_open_ = false;
+    bool external_ = false;
+    
+    SampleRing capture_ring_;
+    SampleRing playback_ring_;
+    int64_t playback_latency_ns_ = 0;            // device buffering, 0 for a caller stream
+    int64_t capture_latency_ns_ = 0;
+    std::atomic<int64_t> played_until_ns_{0};    // steady_clock, see render()
+    
+    // Device frame counters, callback only, and their clocks
+    uint64_t playback_frames_ = 0;
+    uint64_t capture_frames_ = 0;
+    SampleClock playback_clock_;
+    SampleClock capture_clock_;
+    std::atomic<uint64_t> playback_offset_{0};   // device frame - ring position
+    std::atomic<uint64_t> capture_dropped_{0};   // device frames the full ring refused
+    
+    // Lost stretches of the capture ring, newest GAP_HISTORY
+    struct Gap {
+        std::atomic<size_t> position{0};    // first ring position after it
+        std::atomic<uint64_t> lost{0};
+        std::atomic<uint64_t> dropped{0};   // capture_dropped_ including it
+    };
+    static constexpr size_t GAP_HISTORY = 64;
+    Gap gaps_[GAP_HISTORY];
+    std::atomic<size_t> gap_count_{0};
+    std::atomic<uint32_t> gap_seq_{0};
+    std::atomic<uint32_t> capture_generation_{0};
+    std::atomic<bool> playback_streaming_{false};   // write() until wait_played()
     
-    std::vector<float> capture_buffer_;
-    std::vector<float> playback_buffer_;
-    std::atomic<size_t> capture_read_pos_{0};
-    std::atomic<size_t> capture_write_pos_{0};
-    std::atomic<size_t> playback_read_pos_{0};
-    std::atomic<size_t> playback_write_pos_{0};
+    // Overrun / underrun statistics, kept across reconnects
+    std::atomic<uint64_t> capture_overruns_{0};
+    std::atomic<uint64_t> capture_lost_{0};
+    std::atomic<uint64_t> playback_underruns_{0};
+    std::atomic<uint64_t> playback_padded_{0};
+    std::atomic<int> consecutive_overruns_{0};
     
     int consecutive_read_failures_ = 0;
     int consecutive_write_failures_ = 0;
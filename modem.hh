@@ -1,10 +1,12 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 #include <functional>
 #include <atomic>
+#include <string>
 
 
 #include "phy/common.hh"
@@ -418,6 +420,10 @@ public:
     // Parameters: pointer to demodulated symbols, count, modulation bits
     std::function<void(const cmplx*, int, int)> constellation_callback;
     
+    // Called when a frame synced and its meta symbol decoded, but the payload 
+    // failed CRC. get_last_call_sign() still names the sender.
+    std::function<void()> crc_error_callback;
+    
     ModemDecoder() {
         // init fdom_mls before correlator uses it
         init_mls0_seq();
@@ -432,9 +438,14 @@ public:
     
 
     void process(const value* samples, size_t count, FrameCallback callback) {
+        bool dcd = false;
         for (size_t i = 0; i < count; ++i) {
             process_sample(samples[i], callback);
+            dcd = dcd || state_ == State::COLLECTING_SYMBOLS || dcd_hold_ > 0;
         }
+        dcd_.store(dcd, std::memory_order_relaxed);
+        dcd_metric_.store(dcd_peak_, std::memory_order_relaxed);
+        dcd_peak_ = 0;
     }
     
     // Reset decoder state
@@ -444,14 +455,41 @@ public:
         symbol_index_ = 0;
         samples_needed_ = 0;
         k_ = 0;
+        dcd_hold_ = 0;
+        dcd_.store(false, std::memory_order_relaxed);
     }
     
+    // Data carrier detect for the last block passed to process(): a frame
+    // was being collected, or the preamble metric crossed DCD_THRESHOLD
+    // within the last two symbols. Safe to call from another thread.
+    bool carrier_detected() const { return dcd_.load(std::memory_order_relaxed); }
+    
+    // Peak Schmidl-Cox timing metric |P|^2/R^2 of the last block, 0..1
+    value timing_metric() const { return dcd_metric_.load(std::memory_order_relaxed); }
+    
+    static constexpr value DCD_THRESHOLD = 0.1;
+    
     // Get average SNR from last successful decode
     value get_last_snr() const { return last_avg_snr_; }
     
+    // Call sign from the meta symbol of the last synced frame
+    std::string get_last_call_sign() const {
+        const char* p = last_call_sign_;
+        while (*p == ' ') ++p;
+        return p;
+    }
+    
     // Get current modulation bits
     int get_mod_bits() const { return mod_bits; }
     
+    // Input sample (counted from the last reset()) where the preamble of
+    // the last synced frame begins, corrected for the Hilbert filter delay
+    uint64_t get_last_sync_sample() const { return last_sync_sample_; }
+    
+    // Input samples since the last reset(); inside the frame callback, the
+    // end of the frame plus the Hilbert filter delay
+    uint64_t get_sample_count() const { return sample_count_; }
+    
     // decode statistics
     int stats_sync_count = 0;      // corelator   
     int stats_preamble_errors = 0; // preamble decoding failed
@@ -485,6 +523,8 @@ private:
     value cfo_rad;
     int symbol_pos;
     value last_avg_snr_ = 0;  
+    char last_call_sign_[10] = {0};
+    uint64_t last_sync_sample_ = 0;
     
     State state_ = State::SEARCHING;
     size_t sample_count_ = 0;
@@ -494,6 +534,18 @@ private:
     const cmplx* buf_ = nullptr;
     CODE::MLS* seq1_ptr = nullptr;
     
+    // Carrier detect: correlation of each sample with the one a symbol
+    // later (P) and power (R) over the newest two symbols of input_hist,
+    // the same metric the correlator thresholds on. Running sums,
+    // recomputed from the history every two symbols against drift.
+    cmplx dcd_P_ = 0;
+    value dcd_R_ = 0;
+    int dcd_resync_ = 0;
+    int dcd_hold_ = 0;
+    value dcd_peak_ = 0;
+    std::atomic<bool> dcd_{false};
+    std::atomic<value> dcd_metric_{0};
+    
     static int bin(int carrier) {
         return (carrier + symbol_len) % symbol_len;
     }
@@ -616,11 +668,37 @@ private:
         return md;
     }
     
+    void update_dcd() {
+        const int end = buffer_len - 1;
+        if (--dcd_resync_ <= 0) {
+            dcd_P_ = 0;
+            dcd_R_ = 0;
+            for (int i = 0; i < symbol_len; ++i)
+                dcd_P_ += buf_[end - 2 * symbol_len + 1 + i] * conj(buf_[end - symbol_len + 1 + i]);
+            for (int i = 0; i < 2 * symbol_len; ++i)
+                dcd_R_ += norm(buf_[end - i]);
+            dcd_resync_ = 2 * symbol_len;
+        } else {
+            dcd_P_ += buf_[end - symbol_len] * conj(buf_[end]);
+            dcd_P_ -= buf_[end - 2 * symbol_len] * conj(buf_[end - symbol_len]);
+            dcd_R_ += norm(buf_[end]) - norm(buf_[end - 2 * symbol_len]);
+        }
+        
+        value R = std::max(value(0.5) * dcd_R_, value(0.0001) * symbol_len);
+        value metric = norm(dcd_P_) / (R * R);
+        dcd_peak_ = std::max(dcd_peak_, metric);
+        if (metric > DCD_THRESHOLD)
+            dcd_hold_ = 2 * extended_len;
+        else if (dcd_hold_ > 0)
+            --dcd_hold_;
+    }
+    
     void process_sample(value sample, FrameCallback callback) {
         // Convert to complex via Hilbert transform
         cmplx tmp = hilbert(blockdc(sample));
         buf_ = input_hist(tmp);
         ++sample_count_;
+        update_dcd();
         
         switch (state_) {
         case State::SEARCHING:
@@ -629,6 +707,11 @@ private:
                 ++stats_sync_count;
                 symbol_pos = correlator_ptr->symbol_pos;
                 cfo_rad = correlator_ptr->cfo_rad;
+                // buf_ holds the newest buffer_len samples, oldest first
+                {
+                    int64_t pos = int64_t(sample_count_) + symbol_pos - buffer_len - (filter_len - 1) / 2;
+                    last_sync_sample_ = pos > 0 ? uint64_t(pos) : 0;
+                }
                 
                 std::cerr << "Decoder: Sync found at sample " << sample_count_ << std::endl;
                 std::cerr << "Decoder: CFO = " << cfo_rad * (rate / Const::TwoPi()) << " Hz" << std::endl;
@@ -817,6 +900,7 @@ private:
         base40_decoder(call_sign, call, 9);
         call_sign[9] = 0;
         std::cerr << "Decoder: Call sign: " << call_sign << std::endl;
+        std::memcpy(last_call_sign_, call_sign, sizeof(last_call_sign_));
         
         int mode = meta_info & 255;
         if (!setup(mode)) {
@@ -966,6 +1050,9 @@ private:
         if (best < 0) {
             std::cerr << "Decoder: CRC failed" << std::endl;
             ++stats_crc_errors;
+            if (crc_error_callback) {
+                crc_error_callback();
+            }
             return;
         }
         
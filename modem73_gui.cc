@@ -615,7 +615,7 @@ static void draw_settings_panel() {
 
 static void draw_status_tab() {
     float lvl    = g_ui.carrier_level_db.load();
-    float thresh = g_ui.carrier_threshold_db;
+    float thresh = g_ui.busy_threshold_db.load();
     bool  busy   = lvl > thresh;
 
     ImGui::TextDisabled("Signal Level");
@@ -629,9 +629,15 @@ static void draw_status_tab() {
     ImGui::SameLine();
     ImVec4 lvl_col = busy ? ImVec4(1.f,.5f,.1f,1.f) : ImVec4(.3f,1.f,.3f,1.f);
     ImGui::TextColored(lvl_col, "%.1f dB", lvl);
+    if (g_ui.dcd.load()) {
+        ImGui::SameLine();
+        ImGui::TextColored({1.f,.5f,.1f,1.f}, "DCD");
+    }
     ImGui::SameLine(0,20);
     ImGui::TextDisabled("Threshold: %.0f dB", thresh);
     ImGui::SameLine(0,20);
+    ImGui::TextDisabled("Noise: %.1f dB", g_ui.noise_floor_db.load());
+    ImGui::SameLine(0,20);
 
     if (g_ui.csma_enabled) {
         if (busy)
@@ -667,10 +673,54 @@ static void draw_status_tab() {
                    : snr>5.f  ? ImVec4(.9f,.9f,.2f,1.f)
                                : ImVec4(1.f,.4f,.4f,1.f);
     ImGui::TextColored(snr_col, "%.1f dB", snr);
+    if (g_ui.rx_frame_count.load() > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%d ms", g_ui.rx_latency_ms.load());
+    }
     ImGui::SameLine(0,14);
     ImGui::Text("Clients: %d", (int)g_ui.client_count);
     ImGui::SameLine(0,14);
     ImGui::Text("Queue: %d", (int)g_ui.tx_queue_size);
+    ImGui::SameLine(0,14);
+    ImGui::TextDisabled("Drop %llu/%llu  Age %d/%d/%d ms",
+        (unsigned long long)g_ui.tx_queue_dropped.load(),
+        (unsigned long long)g_ui.tx_queue_expired.load(),
+        g_ui.tx_queue_age_p50.load(), g_ui.tx_queue_age_p90.load(), g_ui.tx_queue_age_p99.load());
+    if (uint64_t comp_frames = g_ui.compress_frames.load()) {
+        ImGui::SameLine(0,14);
+        ImGui::TextDisabled("Comp %.0f%%  %llu us",
+            100.0 * g_ui.compress_bytes_out.load() / std::max<uint64_t>(1, g_ui.compress_bytes_in.load()),
+            (unsigned long long)(g_ui.compress_time_us.load() / comp_frames));
+    }
+    if (g_ui.csma_checks.load() > 0) {
+        ImGui::SameLine(0,14);
+        ImGui::TextDisabled("Clear-to-key %.0f/%.0f ms",
+            g_ui.csma_key_avg_ms.load(), g_ui.csma_key_max_ms.load());
+    }
+    if (g_ui.csma_stale.load() > 0) {
+        ImGui::SameLine(0,14);
+        ImGui::TextDisabled("CSMA stale %llu/%llu",
+            (unsigned long long)g_ui.csma_stale.load(),
+            (unsigned long long)g_ui.csma_checks.load());
+    }
+    if (g_ui.rx_duplicates.load() + g_ui.tx_duplicates.load() > 0) {
+        ImGui::SameLine(0,14);
+        ImGui::TextDisabled("Dups %llu/%llu",
+            (unsigned long long)g_ui.rx_duplicates.load(),
+            (unsigned long long)g_ui.tx_duplicates.load());
+    }
+    if (g_ui.audio_overruns.load() > 0) {
+        ImGui::SameLine(0,14);
+        ImGui::TextColored({1.f,.4f,.4f,1.f}, "Overrun %llu (%llu smp, %d rx)",
+            (unsigned long long)g_ui.audio_overruns.load(),
+            (unsigned long long)g_ui.audio_lost.load(), g_ui.rx_overrun_frames.load());
+    }
+    if (g_ui.audio_underruns.load() > 0) {
+        ImGui::SameLine(0,14);
+        ImGui::TextColored({1.f,.4f,.4f,1.f}, "Underrun %llu (%llu smp, %d tx)",
+            (unsigned long long)g_ui.audio_underruns.load(),
+            (unsigned long long)g_ui.audio_padded.load(), g_ui.tx_underrun_frames.load());
+    }
 
     ImGui::Separator();
 
@@ -814,6 +864,8 @@ static void draw_utils_tab() {
         g_ui.preamble_errors= 0;
         g_ui.symbol_errors  = 0;
         g_ui.crc_errors     = 0;
+        g_ui.rx_overrun_frames  = 0;
+        g_ui.tx_underrun_frames = 0;
         g_ui.stats_reset_requested = true;
         g_ui.total_tx_time  = 0.f;
         g_ui.add_log("Stats cleared");
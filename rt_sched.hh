@@ -0,0 +1,145 @@
+#pragma once
+
+// Optional real-time settings for the DSP threads: a fixed-priority
+// scheduling class, pinning to one CPU, and locking the process memory so
+// the decoder never takes a page fault mid-frame. Everything here is best
+// effort; without the privileges (CAP_SYS_NICE, RLIMIT_RTPRIO,
+// RLIMIT_MEMLOCK) a call fails, says why, and the thread keeps running as
+// before. Future pages are only locked where that can't run into
+// RLIMIT_MEMLOCK and make later allocations fail.
+//
+// Linux has all of it. Windows maps priority to TIME_CRITICAL and pinning
+// to an affinity mask; other systems only get the scheduling class.
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+#ifdef __linux__
+#include <fstream>
+#include <linux/capability.h>
+#endif
+
+namespace RtSched {
+
+// Scheduling class and priority (1-99) for the calling thread; FIFO, or
+// round robin between threads of equal priority
+inline bool set_priority(int priority, bool round_robin, std::string& result) {
+#ifdef _WIN32
+    (void)priority;
+    (void)round_robin;
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        result = "priority refused (error " + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+    result = "TIME_CRITICAL";
+    return true;
+#else
+    int policy = round_robin ? SCHED_RR : SCHED_FIFO;
+    int lo = sched_get_priority_min(policy);
+    int hi = sched_get_priority_max(policy);
+    sched_param param{};
+    param.sched_priority = priority < lo ? lo : priority > hi ? hi : priority;
+    int err = pthread_setschedparam(pthread_self(), policy, &param);
+    if (err != 0) {
+        result = std::string(round_robin ? "SCHED_RR" : "SCHED_FIFO") + " refused (" + std::strerror(err) + ")";
+        return false;
+    }
+    result = std::string(round_robin ? "SCHED_RR " : "SCHED_FIFO ") + std::to_string(param.sched_priority);
+    return true;
+#endif
+}
+
+// Keeps the calling thread on one CPU
+inline bool pin_cpu(int cpu, std::string& result) {
+#if defined(_WIN32)
+    if (cpu < 0 || cpu >= 64 || !SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu)) {
+        result = "CPU " + std::to_string(cpu) + " refused";
+        return false;
+    }
+    result = "CPU " + std::to_string(cpu);
+    return true;
+#elif defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        result = "CPU " + std::to_string(cpu) + " out of range";
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        result = "CPU " + std::to_string(cpu) + " refused (" + std::strerror(err) + ")";
+        return false;
+    }
+    result = "CPU " + std::to_string(cpu);
+    return true;
+#else
+    result = "CPU pinning not supported";
+    (void)cpu;
+    return false;
+#endif
+}
+
+// True if the process may lock any amount of memory: RLIMIT_MEMLOCK is
+// unlimited, or it holds CAP_IPC_LOCK
+inline bool memlock_unlimited() {
+#ifdef _WIN32
+    return false;
+#else
+    rlimit limit{};
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) return true;
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 7, "CapEff:") == 0) {
+            unsigned long long caps = std::strtoull(line.c_str() + 7, nullptr, 16);
+            return (caps >> CAP_IPC_LOCK) & 1;
+        }
+    }
+#endif
+    return false;
+#endif
+}
+
+// Locks every page the process has into RAM, and every page it will map
+// if memlock_unlimited(). Under a finite limit MCL_FUTURE would make
+// allocations fail once it is used up, so new pages then stay pageable.
+inline bool lock_memory(std::string& result) {
+#ifdef _WIN32
+    result = "not supported";
+    return false;
+#else
+    bool future = memlock_unlimited();
+    if (mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0)) != 0) {
+        result = std::string("refused (") + std::strerror(errno) + ")";
+        return false;
+    }
+    result = future ? "locked" : "locked, current pages only (RLIMIT_MEMLOCK is finite, no CAP_IPC_LOCK)";
+    return true;
+#endif
+}
+
+// Touches the top of the calling thread's stack so its pages are mapped
+// (and, after lock_memory(), locked) before the first real-time deadline
+inline void prefault_stack() {
+    constexpr size_t STACK_PREFAULT = 256 * 1024;
+    volatile unsigned char stack[STACK_PREFAULT];
+    for (size_t i = 0; i < STACK_PREFAULT; i += 4096) stack[i] = 0;
+    (void)stack[0];
+}
+
+} // namespace RtSched
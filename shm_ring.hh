@@ -0,0 +1,369 @@
+#pragma once
+
+// Shared-memory KISS transport for clients on the same machine. Two
+// single-producer/single-consumer byte rings carry the same KISS byte
+// stream as the TCP server, one per direction, so framing and commands are
+// identical; a frame costs a memcpy and an atomic store instead of a
+// send()/recv() pair.
+//
+// Layout of the mapping (all indices little endian, free running, masked
+// with capacity - 1):
+//   Header   magic, version, capacity, attached, session
+//   Ring     to_tnc:   head (client writes), tail (TNC writes)
+//   Ring     from_tnc: head (TNC writes),    tail (client writes)
+//   Bell     tnc, client
+//   uint8_t  to_tnc data[capacity]
+//   uint8_t  from_tnc data[capacity]
+//
+// The TNC creates the mapping; one client at a time opens it: open()
+// fails while attached is set. Attaching skips anything left in from_tnc
+// and starts a new session, which the TNC acknowledges once it has dropped
+// what an earlier client left in to_tnc, half-written frames included;
+// open() returns only then, so nothing of the new client is lost. The TNC
+// discards output while no client is attached.
+//
+// Each side has a bell the other rings whenever it moves an index (new
+// data, or space freed), so neither has to spin: take bell(), service the
+// rings, then wait(seen, timeout). On Linux the bell is a futex in the
+// mapping and ringing it is one atomic add unless the peer sleeps; other
+// systems fall back to polling every millisecond.
+
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <chrono>
+#include <thread>
+
+namespace ShmRing {
+    constexpr uint32_t MAGIC = 0x4D373352;   // "M73R"
+    constexpr uint32_t VERSION = 3;
+    constexpr uint32_t DEFAULT_CAPACITY = 1 << 20;
+    constexpr size_t CACHE_LINE = 64;
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared ring needs lock-free atomics");
+
+    // Producer and consumer index on separate cache lines
+    struct Indices {
+        alignas(CACHE_LINE) std::atomic<uint32_t> head{0};
+        alignas(CACHE_LINE) std::atomic<uint32_t> tail{0};
+    };
+
+    // Wakeup word: seq moves on every ring, waiters says whether a futex
+    // wake is needed
+    struct alignas(CACHE_LINE) Bell {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint32_t> waiters{0};
+        
+        void ring() {
+            seq.fetch_add(1, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+#ifdef __linux__
+            if (waiters.load(std::memory_order_relaxed)) {
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+            }
+#endif
+        }
+        
+        // true once seq has moved past seen, false on timeout (-1 = none)
+        bool wait(uint32_t seen, int timeout_ms) {
+#ifdef __linux__
+            waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (seq.load(std::memory_order_acquire) == seen) {
+                timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT, seen,
+                        timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+            }
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+#else
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (seq.load(std::memory_order_acquire) == seen &&
+                   (timeout_ms < 0 || std::chrono::steady_clock::now() < deadline)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+#endif
+            return seq.load(std::memory_order_acquire) != seen;
+        }
+    };
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain uint32_t");
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        std::atomic<uint32_t> attached{0};
+        std::atomic<uint32_t> session{0};       // bumped by every attach
+        std::atomic<uint32_t> session_ack{0};   // TNC: session it has reset for
+        Indices to_tnc;
+        Indices from_tnc;
+        Bell tnc_bell;
+        Bell client_bell;
+    };
+
+    inline size_t mapping_size(uint32_t capacity) {
+        return sizeof(Header) + 2 * size_t(capacity);
+    }
+
+    // One direction of the transport. Only one thread may write and only
+    // one thread may read. Both ring the peer's bell.
+    class Ring {
+    public:
+        Ring() = default;
+        Ring(Indices* idx, uint8_t* data, uint32_t capacity, Bell* peer)
+            : idx_(idx), data_(data), mask_(capacity - 1), peer_(peer) {}
+
+        // Writes as much as fits, returns the number of bytes written
+        size_t write(const uint8_t* src, size_t len) {
+            uint32_t head = idx_->head.load(std::memory_order_relaxed);
+            uint32_t tail = idx_->tail.load(std::memory_order_acquire);
+            size_t space = (mask_ + 1) - (head - tail);
+            len = std::min(len, space);
+            copy_in(head, src, len);
+            idx_->head.store(head + static_cast<uint32_t>(len), std::memory_order_release);
+            if (len) peer_->ring();
+            return len;
+        }
+
+        size_t read(uint8_t* dst, size_t len) {
+            uint32_t tail = idx_->tail.load(std::memory_order_relaxed);
+            uint32_t head = idx_->head.load(std::memory_order_acquire);
+            len = std::min(len, size_t(head - tail));
+            copy_out(tail, dst, len);
+            idx_->tail.store(tail + static_cast<uint32_t>(len), std::memory_order_release);
+            if (len) peer_->ring();
+            return len;
+        }
+
+        // Consumer side: drop everything queued
+        void skip() {
+            idx_->tail.store(idx_->head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        bool valid() const { return idx_ != nullptr; }
+
+    private:
+        void copy_in(uint32_t pos, const uint8_t* src, size_t len) {
+            size_t off = pos & mask_;
+            size_t first = std::min(len, size_t(mask_ + 1) - off);
+            std::memcpy(data_ + off, src, first);
+            std::memcpy(data_, src + first, len - first);
+        }
+
+        void copy_out(uint32_t pos, uint8_t* dst, size_t len) {
+            size_t off = pos & mask_;
+            size_t first = std::min(len, size_t(mask_ + 1) - off);
+            std::memcpy(dst, data_ + off, first);
+            std::memcpy(dst + first, data_, len - first);
+        }
+
+        Indices* idx_ = nullptr;
+        uint8_t* data_ = nullptr;
+        uint32_t mask_ = 0;
+        Bell* peer_ = nullptr;
+    };
+
+    // A named mapping holding both rings. The TNC calls create(), clients
+    // call open(); rx()/tx() are from the caller's point of view.
+    class Transport {
+    public:
+        Transport() = default;
+        Transport(const Transport&) = delete;
+        Transport& operator=(const Transport&) = delete;
+        ~Transport() { close(); }
+
+        // capacity is rounded up to a power of two
+        bool create(const std::string& name, uint32_t capacity = DEFAULT_CAPACITY) {
+            uint32_t cap = 4096;
+            while (cap < capacity && cap < (1u << 30)) cap <<= 1;
+            if (!map(name, mapping_size(cap), true)) return false;
+
+            owner_ = true;
+            header_ = new (base_) Header();
+            header_->magic = MAGIC;
+            header_->version = VERSION;
+            header_->capacity = cap;
+            setup_rings(false);
+            return true;
+        }
+
+        static constexpr int ATTACH_TIMEOUT_MS = 1000;
+
+        bool open(const std::string& name) {
+            if (!map(name, sizeof(Header), false)) return false;
+            const Header* h = reinterpret_cast<const Header*>(base_);
+            uint32_t cap = h->capacity;
+            bool ok = h->magic == MAGIC && h->version == VERSION && cap && !(cap & (cap - 1));
+            unmap();
+            if (!ok || !map(name, mapping_size(cap), false)) return false;
+
+            header_ = reinterpret_cast<Header*>(base_);
+            uint32_t free = 0;
+            if (!header_->attached.compare_exchange_strong(free, 1, std::memory_order_acq_rel)) {
+                // Another client owns the rings
+                header_ = nullptr;
+                unmap();
+                return false;
+            }
+            setup_rings(true);
+            rx_.skip();
+            
+            // Wait for the TNC to clear the way before writing anything
+            uint32_t session = header_->session.fetch_add(1, std::memory_order_acq_rel) + 1;
+            header_->tnc_bell.ring();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ATTACH_TIMEOUT_MS);
+            while (header_->session_ack.load(std::memory_order_acquire) != session) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    close();   // no TNC serving the mapping
+                    return false;
+                }
+                uint32_t seen = bell();
+                if (header_->session_ack.load(std::memory_order_acquire) == session) break;
+                wait(seen, static_cast<int>(left));
+            }
+            return true;
+        }
+        
+        // TNC side: true once per attach. Everything still in to_tnc came
+        // from an earlier client and is dropped; the new client starts
+        // writing once this returns.
+        bool new_session() {
+            uint32_t session = header_->session.load(std::memory_order_acquire);
+            if (session == header_->session_ack.load(std::memory_order_relaxed)) return false;
+            rx_.skip();
+            header_->session_ack.store(session, std::memory_order_release);
+            header_->client_bell.ring();
+            return true;
+        }
+
+        void close() {
+            if (!base_) return;
+            if (!owner_) header_->attached.store(0, std::memory_order_release);
+            unmap();
+#ifndef _WIN32
+            if (owner_) shm_unlink(path_.c_str());
+#endif
+            owner_ = false;
+            header_ = nullptr;
+            rx_ = Ring();
+            tx_ = Ring();
+            own_bell_ = nullptr;
+        }
+
+        bool is_open() const { return base_ != nullptr; }
+        bool attached() const {
+            return header_ && header_->attached.load(std::memory_order_acquire) != 0;
+        }
+
+        Ring& rx() { return rx_; }
+        Ring& tx() { return tx_; }
+        
+        // Our bell: snapshot it before servicing the rings, then wait() for
+        // the peer to move anything after that
+        uint32_t bell() const { return own_bell_->seq.load(std::memory_order_acquire); }
+        bool wait(uint32_t seen, int timeout_ms) { return own_bell_->wait(seen, timeout_ms); }
+
+    private:
+        void setup_rings(bool client) {
+            uint32_t cap = header_->capacity;
+            uint8_t* to_tnc = reinterpret_cast<uint8_t*>(base_) + sizeof(Header);
+            uint8_t* from_tnc = to_tnc + cap;
+            Bell* own = client ? &header_->client_bell : &header_->tnc_bell;
+            Bell* peer = client ? &header_->tnc_bell : &header_->client_bell;
+            Ring to(&header_->to_tnc, to_tnc, cap, peer);
+            Ring from(&header_->from_tnc, from_tnc, cap, peer);
+            rx_ = client ? from : to;
+            tx_ = client ? to : from;
+            own_bell_ = own;
+        }
+
+#ifdef _WIN32
+        bool map(const std::string& name, size_t size, bool create) {
+            path_ = "Local\\modem73-" + name;
+            if (create) {
+                handle_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                             static_cast<DWORD>(uint64_t(size) >> 32),
+                                             static_cast<DWORD>(size), path_.c_str());
+            } else {
+                handle_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path_.c_str());
+            }
+            if (!handle_) return false;
+            base_ = MapViewOfFile(handle_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+            if (!base_) {
+                CloseHandle(handle_);
+                handle_ = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        void unmap() {
+            if (base_) UnmapViewOfFile(base_);
+            if (handle_) CloseHandle(handle_);
+            base_ = nullptr;
+            handle_ = nullptr;
+        }
+
+        HANDLE handle_ = nullptr;
+#else
+        bool map(const std::string& name, size_t size, bool create) {
+            path_ = name.empty() || name[0] != '/' ? "/" + name : name;
+            int fd = shm_open(path_.c_str(), create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0600);
+            if (fd < 0) return false;
+            if (create && ftruncate(fd, static_cast<off_t>(size)) < 0) {
+                ::close(fd);
+                shm_unlink(path_.c_str());
+                return false;
+            }
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED) {
+                if (create) shm_unlink(path_.c_str());
+                return false;
+            }
+            base_ = p;
+            size_ = size;
+            return true;
+        }
+
+        void unmap() {
+            if (base_) munmap(base_, size_);
+            base_ = nullptr;
+            size_ = 0;
+        }
+
+        size_t size_ = 0;
+#endif
+
+        std::string path_;
+        void* base_ = nullptr;
+        Header* header_ = nullptr;
+        bool owner_ = false;
+        Ring rx_;
+        Ring tx_;
+        Bell* own_bell_ = nullptr;
+    };
+}
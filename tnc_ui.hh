@@ -145,8 +145,27 @@ struct TNCUIState {
     std::atomic<bool> transmitting{false};
     std::atomic<int> client_count{0};
     std::atomic<int> tx_queue_size{0};
+    std::atomic<uint64_t> tx_queue_dropped{0};   // rejected/evicted when full
+    std::atomic<uint64_t> tx_queue_expired{0};   // TTL ran out before TX
+    std::atomic<int> tx_queue_age_p50{0};        // ms
+    std::atomic<int> tx_queue_age_p90{0};
+    std::atomic<int> tx_queue_age_p99{0};
+    std::atomic<uint64_t> compress_bytes_in{0};   // payload compression attempts
+    std::atomic<uint64_t> compress_bytes_out{0};
+    std::atomic<uint64_t> compress_frames{0};
+    std::atomic<uint64_t> compress_time_us{0};
+    std::atomic<uint64_t> rx_duplicates{0};       // suppressed duplicate deliveries
+    std::atomic<uint64_t> tx_duplicates{0};       // dropped duplicate submissions
+    std::atomic<uint64_t> csma_checks{0};         // carrier sense decisions
+    std::atomic<uint64_t> csma_stale{0};          // ... made on a level older than the window
+    std::atomic<float> csma_key_avg_ms{0.0f};     // channel clear to PTT, mean
+    std::atomic<float> csma_key_max_ms{0.0f};
     std::atomic<float> last_rx_snr{0.0f};
+    std::atomic<int> rx_latency_ms{0};            // preamble capture to decoded frame
     std::atomic<float> carrier_level_db{-100.0f};
+    std::atomic<bool> dcd{false};                 // decoder sees a preamble or frame
+    std::atomic<float> noise_floor_db{-100.0f};   // tracked band noise floor
+    std::atomic<float> busy_threshold_db{-30.0f}; // threshold CSMA actually uses
     std::atomic<int> rx_frame_count{0};
     std::atomic<int> tx_frame_count{0};
     std::atomic<int> rx_error_count{0};
@@ -158,6 +177,15 @@ struct TNCUIState {
     std::atomic<int> crc_errors{0};
     std::atomic<bool> stats_reset_requested{false};
     
+    // Audio path: samples lost to a late reader, or padded into a
+    // transmission by a late writer (CPU starvation, not RF)
+    std::atomic<uint64_t> audio_overruns{0};      // capture callbacks cut short
+    std::atomic<uint64_t> audio_lost{0};          // ... samples dropped
+    std::atomic<uint64_t> audio_underruns{0};     // playback ran dry mid-TX
+    std::atomic<uint64_t> audio_padded{0};        // ... silence samples inserted
+    std::atomic<int> rx_overrun_frames{0};        // decoded frames spanning an overrun
+    std::atomic<int> tx_underrun_frames{0};       // frames sent with a gap
+    
     // Signal visualization
     static constexpr int LEVEL_HISTORY_SIZE = 60;
     std::mutex level_mutex;
@@ -1736,7 +1764,8 @@ private:
 
         mvaddstr(y, c1, "Carrier");
         float lvl = state_.carrier_level_db.load();
-        bool busy = lvl > state_.carrier_threshold_db;
+        float busy_thresh = state_.busy_threshold_db.load();
+        bool busy = lvl > busy_thresh;
         move(y, c2);
         if (busy) {
             attron(COLOR_PAIR(4) | A_BOLD);  
@@ -1747,16 +1776,30 @@ private:
             printw("%6.1f dB", lvl);
             attroff(COLOR_PAIR(1) | A_BOLD);
         }
+        if (state_.dcd.load()) {
+            attron(COLOR_PAIR(4) | A_BOLD);
+            printw(" DCD");
+            attroff(COLOR_PAIR(4) | A_BOLD);
+        }
         y++;
         
         //  Meter
         mvaddstr(y, c1, "Level");
         move(y, c2);
-        draw_level_meter(lvl, state_.carrier_threshold_db, 20);
+        draw_level_meter(lvl, busy_thresh, 20);
         y++;
         
         mvaddstr(y, c1, "Threshold");
-        mvprintw(y, c2, "%6.0f dB", state_.carrier_threshold_db);
+        mvprintw(y, c2, "%6.0f dB", busy_thresh);
+        if (std::fabs(busy_thresh - state_.carrier_threshold_db) >= 0.5f) {
+            attron(A_DIM);
+            printw(" auto");
+            attroff(A_DIM);
+        }
+        y++;
+        
+        mvaddstr(y, c1, "Noise");
+        mvprintw(y, c2, "%6.1f dB", state_.noise_floor_db.load());
         y++;
         
         mvaddstr(y, c1, "Last SNR");
@@ -1771,6 +1814,10 @@ private:
         attroff(COLOR_PAIR(3) | A_BOLD);
         y++;
         
+        mvaddstr(y, c1, "Latency");
+        mvprintw(y, c2, "%6d ms", state_.rx_latency_ms.load());
+        y++;
+        
         // SNR history 
         mvaddstr(y, c1, "SNR Hist");
         move(y, c2);
@@ -1887,6 +1934,58 @@ private:
         
         addstr("  Queue");
         printw(" %d", state_.tx_queue_size.load());
+        uint64_t q_dropped = state_.tx_queue_dropped.load() + state_.tx_queue_expired.load();
+        if (q_dropped > 0) {
+            attron(COLOR_PAIR(3));
+            printw(" (-%llu)", (unsigned long long)q_dropped);
+            attroff(COLOR_PAIR(3));
+        }
+        y++;
+        
+        mvaddstr(y, c3, "Q age");
+        attron(A_DIM);
+        mvprintw(y, c4, "p50 %d  p90 %d  p99 %d ms",
+                 state_.tx_queue_age_p50.load(),
+                 state_.tx_queue_age_p90.load(),
+                 state_.tx_queue_age_p99.load());
+        attroff(A_DIM);
+        
+        uint64_t comp_frames = state_.compress_frames.load();
+        if (comp_frames > 0) {
+            y++;
+            mvaddstr(y, c3, "Comp");
+            attron(A_DIM);
+            mvprintw(y, c4, "%.0f%% of size  %llu us/frame",
+                     100.0 * state_.compress_bytes_out.load() / std::max<uint64_t>(1, state_.compress_bytes_in.load()),
+                     (unsigned long long)(state_.compress_time_us.load() / comp_frames));
+            attroff(A_DIM);
+        }
+        
+        uint64_t csma_checks = state_.csma_checks.load();
+        uint64_t csma_stale = state_.csma_stale.load();
+        if (csma_checks > 0) {
+            y++;
+            mvaddstr(y, c3, "CSMA");
+            attron(A_DIM);
+            mvprintw(y, c4, "key %.0f ms avg, %.0f max",
+                     state_.csma_key_avg_ms.load(), state_.csma_key_max_ms.load());
+            if (csma_stale > 0) {
+                printw("  %llu/%llu stale",
+                       (unsigned long long)csma_stale, (unsigned long long)csma_checks);
+            }
+            attroff(A_DIM);
+        }
+        
+        uint64_t rx_dups = state_.rx_duplicates.load();
+        uint64_t tx_dups = state_.tx_duplicates.load();
+        if (rx_dups + tx_dups > 0) {
+            y++;
+            mvaddstr(y, c3, "Dups");
+            attron(A_DIM);
+            mvprintw(y, c4, "RX %llu  TX %llu suppressed",
+                     (unsigned long long)rx_dups, (unsigned long long)tx_dups);
+            attroff(A_DIM);
+        }
         
 
         y += 2;
@@ -2814,6 +2913,21 @@ private:
             attroff(COLOR_PAIR(2));
         }
         
+        uint64_t overruns = state_.audio_overruns.load();
+        uint64_t underruns = state_.audio_underruns.load();
+        if (overruns > 0) {
+            addstr("  Overrun");
+            attron(COLOR_PAIR(2));
+            printw(" %llu/%llu", (unsigned long long)overruns, (unsigned long long)state_.audio_lost.load());
+            attroff(COLOR_PAIR(2));
+        }
+        if (underruns > 0) {
+            addstr("  Underrun");
+            attron(COLOR_PAIR(2));
+            printw(" %llu/%llu", (unsigned long long)underruns, (unsigned long long)state_.audio_padded.load());
+            attroff(COLOR_PAIR(2));
+        }
+        
         y += 2;
         h -= 3;
         
@@ -3308,6 +3422,8 @@ private:
                 state_.preamble_errors = 0;
                 state_.symbol_errors = 0;
                 state_.crc_errors = 0;
+                state_.rx_overrun_frames = 0;
+                state_.tx_underrun_frames = 0;
                 state_.stats_reset_requested = true;
                 state_.total_tx_time = 0;
                 state_.add_log("S");
@@ -14,6 +14,7 @@
 
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <afunix.h>   // AF_UNIX, Windows 10 1803+
 
 // Winsock2 / winnt.h definiuje makro IN= do SAL annotations - koliduje z
 // nazwami template parameters w aicodix (template<typename IN>).